@@ -0,0 +1,387 @@
+#include "../src/Lvk/Lvk.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** Frame-time benchmark of `Lvk::draw_frame()` on the default scene */
+// Usage: Bench [--headless] [--frames N] [--warmup N] [--output path]
+//              [--label text] [--frames-in-flight N]
+//              [--cache-command-buffers] [--recording-threads N]
+//              [--no-timeline-semaphore]
+//              [--present-policy latency|power|throughput]
+//              [--max-queued-presents N] [--pipeline-threads N]
+//              [--no-host-allocator] [--no-transfer-queue] [--instances N]
+//              [--gpu-objects N] [--verbose] [--trace path]
+
+struct BenchOptions {
+  bool headless = false;
+  // Frames measured (after the warmup)
+  uint32_t frames = 1000;
+  // Frames drawn before measuring (pipeline/driver caches, clocks, ...)
+  uint32_t warmup = 60;
+  std::string output = "build/bench.json";
+  // Free text stored in the results (e.g. the commit being measured)
+  std::string label;
+  uint32_t frames_in_flight = 2;
+  bool cache_command_buffers = false;
+  uint32_t recording_threads = 0;
+  bool timeline_semaphore = true;
+  utils::swapchain::PresentPolicy present_policy =
+      utils::swapchain::PresentPolicy::LOWEST_LATENCY;
+  uint32_t max_queued_presents = 1;
+  uint32_t pipeline_compile_threads = 2;
+  bool host_allocator = true;
+  bool transfer_queue = true;
+  // Instances of the default mesh drawn each frame (with one instanced draw)
+  uint32_t instances = 0;
+  // Objects of the default mesh culled and drawn by the GPU (uploaded once)
+  uint32_t gpu_objects = 0;
+  bool verbose = false;
+  // Chrome trace of the initialization ("" = not traced)
+  std::string trace_path;
+};
+
+/** Summary of the samples of one metric */
+struct Stats {
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+/** Nearest-rank percentile of sorted samples */
+static double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+
+  // Smallest sample with at least `p`% of the samples at or below it (rank
+  // counted from 1)
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size() / 100.0));
+  rank = std::clamp<size_t>(rank, 1, sorted.size());
+  return sorted[rank - 1];
+}
+
+static Stats compute_stats(std::vector<double> samples) {
+  Stats stats;
+  if (samples.empty()) {
+    return stats;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  double sum = 0.0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+
+  stats.mean = sum / samples.size();
+  stats.p50 = percentile(samples, 50.0);
+  stats.p95 = percentile(samples, 95.0);
+  stats.p99 = percentile(samples, 99.0);
+  stats.max = samples.back();
+
+  return stats;
+}
+
+/** Escape the characters that would break a JSON string */
+static std::string json_escape(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+
+  return escaped;
+}
+
+static void write_stats(std::ostream &out, const std::string &name,
+                        const Stats &stats, bool last) {
+  out << "    \"" << name << "\": {\"mean\": " << stats.mean
+      << ", \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95
+      << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << "}"
+      << (last ? "" : ",") << "\n";
+}
+
+static void print_stats(const std::string &name, const Stats &stats) {
+  std::cout << "  " << name << ": mean " << stats.mean << " | p50 "
+            << stats.p50 << " | p95 " << stats.p95 << " | p99 " << stats.p99
+            << " | max " << stats.max << " (ms)" << std::endl;
+}
+
+/** Value of the numeric option `arg` (a count, 32 bits) */
+static uint32_t parse_count(const std::string &arg, const char *value) {
+  // `std::stoul` alone accepts a sign, leading spaces, trailing characters
+  // and values that don't fit in 32 bits
+  std::string text = value;
+  size_t end = 0;
+  unsigned long count = 0;
+
+  if (!text.empty() && std::isdigit(static_cast<unsigned char>(text[0]))) {
+    try {
+      count = std::stoul(text, &end);
+    } catch (const std::exception &) {
+      end = 0;
+    }
+  }
+
+  if (end == 0 || end != text.size() || count > UINT32_MAX) {
+    throw std::runtime_error("Invalid value for " + arg + ": " + text);
+  }
+
+  return static_cast<uint32_t>(count);
+}
+
+static BenchOptions parse_options(int argc, char **argv) {
+  BenchOptions options;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--frames" && i + 1 < argc) {
+      options.frames = parse_count(arg, argv[++i]);
+    } else if (arg == "--warmup" && i + 1 < argc) {
+      options.warmup = parse_count(arg, argv[++i]);
+    } else if (arg == "--output" && i + 1 < argc) {
+      options.output = argv[++i];
+    } else if (arg == "--label" && i + 1 < argc) {
+      options.label = argv[++i];
+    } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+      options.frames_in_flight = parse_count(arg, argv[++i]);
+    } else if (arg == "--cache-command-buffers") {
+      options.cache_command_buffers = true;
+    } else if (arg == "--recording-threads" && i + 1 < argc) {
+      options.recording_threads = parse_count(arg, argv[++i]);
+    } else if (arg == "--no-timeline-semaphore") {
+      options.timeline_semaphore = false;
+    } else if (arg == "--present-policy" && i + 1 < argc) {
+      options.present_policy =
+          utils::swapchain::parse_present_policy(argv[++i]);
+    } else if (arg == "--max-queued-presents" && i + 1 < argc) {
+      options.max_queued_presents = parse_count(arg, argv[++i]);
+    } else if (arg == "--pipeline-threads" && i + 1 < argc) {
+      options.pipeline_compile_threads = parse_count(arg, argv[++i]);
+    } else if (arg == "--no-host-allocator") {
+      options.host_allocator = false;
+    } else if (arg == "--no-transfer-queue") {
+      options.transfer_queue = false;
+    } else if (arg == "--instances" && i + 1 < argc) {
+      options.instances = parse_count(arg, argv[++i]);
+    } else if (arg == "--gpu-objects" && i + 1 < argc) {
+      options.gpu_objects = parse_count(arg, argv[++i]);
+    } else if (arg == "--verbose") {
+      options.verbose = true;
+    } else if (arg == "--trace" && i + 1 < argc) {
+      options.trace_path = argv[++i];
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+
+  return options;
+}
+
+int main(int argc, char **argv) {
+  try {
+    BenchOptions options = parse_options(argc, argv);
+
+    lvk::Config config;
+    config.headless = options.headless;
+    config.frames_in_flight = options.frames_in_flight;
+    config.cache_command_buffers = options.cache_command_buffers;
+    config.recording_threads = options.recording_threads;
+    config.timeline_semaphore = options.timeline_semaphore;
+    config.present_policy = options.present_policy;
+    config.max_queued_presents = options.max_queued_presents;
+    config.pipeline_compile_threads = options.pipeline_compile_threads;
+    config.host_allocator = options.host_allocator;
+    config.transfer_queue = options.transfer_queue;
+    config.verbose = options.verbose;
+    config.trace_path = options.trace_path;
+    // GPU timings averaged over all the measured frames
+    config.gpu_timing_window = options.frames;
+
+    lvk::Lvk app(config);
+
+    // Grid of small triangles covering the viewport, queued again each frame
+    std::vector<lvk::Instance> instances(options.instances);
+    uint32_t columns = static_cast<uint32_t>(
+        std::ceil(std::sqrt(static_cast<double>(options.instances))));
+    for (uint32_t i = 0; i < options.instances; ++i) {
+      float cell = 2.0f / columns;
+      instances[i].translation[0] = -1.0f + cell * (i % columns + 0.5f);
+      instances[i].translation[1] = -1.0f + cell * (i / columns + 0.5f);
+      instances[i].scale = cell;
+    }
+
+    // Grid four times as large as the viewport: most objects are culled
+    if (options.gpu_objects > 0) {
+      std::vector<lvk::GpuObject> objects(options.gpu_objects);
+      uint32_t gpu_columns = static_cast<uint32_t>(
+          std::ceil(std::sqrt(static_cast<double>(options.gpu_objects))));
+      for (uint32_t i = 0; i < options.gpu_objects; ++i) {
+        float cell = 4.0f / gpu_columns;
+        objects[i].instance.translation[0] =
+            -2.0f + cell * (i % gpu_columns + 0.5f);
+        objects[i].instance.translation[1] =
+            -2.0f + cell * (i / gpu_columns + 0.5f);
+        objects[i].instance.scale = cell;
+        // Around the vertices of the default triangle
+        objects[i].radius = 0.75f;
+      }
+      app.set_gpu_objects(objects);
+    }
+
+    auto draw_frame = [&app, &instances]() {
+      if (!instances.empty()) {
+        app.draw_instances(0, instances.data(), instances.size());
+      }
+      app.draw_frame();
+    };
+
+    for (uint32_t i = 0; i < options.warmup && !app.should_close(); ++i) {
+      app.poll_events();
+      draw_frame();
+    }
+
+    /** Measured frames */
+    std::vector<double> cpu_frame, present_wait, wait, acquire, record, submit, present;
+    // Host allocations made by the driver (0 with `--no-host-allocator`)
+    std::vector<double> host_allocations, host_allocated_bytes;
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t frames = 0;
+
+    for (; frames < options.frames && !app.should_close(); ++frames) {
+      app.poll_events();
+      draw_frame();
+
+      const lvk::FrameTimings &timings = app.get_frame_timings();
+      cpu_frame.push_back(timings.cpu_frame_ms);
+      present_wait.push_back(timings.present_wait_ms);
+      wait.push_back(timings.wait_ms);
+      acquire.push_back(timings.acquire_ms);
+      record.push_back(timings.record_ms);
+      submit.push_back(timings.submit_ms);
+      present.push_back(timings.present_ms);
+      host_allocations.push_back(timings.host_allocations);
+      host_allocated_bytes.push_back(timings.host_allocated_bytes);
+    }
+
+    double total_s = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    double fps = total_s > 0.0 ? frames / total_s : 0.0;
+
+    Stats cpu_frame_stats = compute_stats(cpu_frame);
+    Stats present_wait_stats = compute_stats(present_wait);
+    Stats wait_stats = compute_stats(wait);
+    Stats acquire_stats = compute_stats(acquire);
+    Stats record_stats = compute_stats(record);
+    Stats submit_stats = compute_stats(submit);
+    Stats present_stats = compute_stats(present);
+    Stats host_allocations_stats = compute_stats(host_allocations);
+    Stats host_allocated_bytes_stats = compute_stats(host_allocated_bytes);
+
+    std::cout << "\nFrames: " << frames << " in " << total_s << "s ("
+              << fps << " frames/s)" << std::endl;
+    print_stats("cpu_frame", cpu_frame_stats);
+    print_stats("present_wait", present_wait_stats);
+    print_stats("wait", wait_stats);
+    print_stats("acquire", acquire_stats);
+    print_stats("record", record_stats);
+    print_stats("submit", submit_stats);
+    print_stats("present", present_stats);
+    std::cout << "  host allocations per frame: mean "
+              << host_allocations_stats.mean << " | max "
+              << host_allocations_stats.max << " ("
+              << host_allocated_bytes_stats.mean << " bytes mean)"
+              << std::endl;
+
+    // Rolling window of the GPU timestamps (lags a few frames behind the CPU)
+    std::vector<lvk::GpuPassTiming> gpu_timings = app.get_gpu_timings();
+    for (const auto &timing : gpu_timings) {
+      std::cout << "  gpu " << timing.name << ": mean " << timing.average_ms
+                << " | max " << timing.max_ms << " (ms)" << std::endl;
+    }
+
+    /** Results as JSON */
+    std::ofstream out(options.output);
+    if (!out.is_open()) {
+      throw std::runtime_error("failed to open " + options.output);
+    }
+
+    out << "{\n";
+    out << "  \"label\": \"" << json_escape(options.label) << "\",\n";
+    out << "  \"headless\": " << (options.headless ? "true" : "false")
+        << ",\n";
+    out << "  \"frames\": " << frames << ",\n";
+    out << "  \"warmup\": " << options.warmup << ",\n";
+    out << "  \"frames_in_flight\": " << options.frames_in_flight << ",\n";
+    out << "  \"cache_command_buffers\": "
+        << (options.cache_command_buffers ? "true" : "false") << ",\n";
+    out << "  \"recording_threads\": " << options.recording_threads << ",\n";
+    out << "  \"timeline_semaphore\": "
+        << (options.timeline_semaphore ? "true" : "false") << ",\n";
+    out << "  \"present_policy\": \""
+        << utils::swapchain::present_policy_name(options.present_policy)
+        << "\",\n";
+    out << "  \"max_queued_presents\": " << options.max_queued_presents
+        << ",\n";
+    out << "  \"pipeline_threads\": " << options.pipeline_compile_threads
+        << ",\n";
+    out << "  \"host_allocator\": "
+        << (options.host_allocator ? "true" : "false") << ",\n";
+    out << "  \"transfer_queue\": "
+        << (options.transfer_queue ? "true" : "false") << ",\n";
+    out << "  \"instances\": " << options.instances << ",\n";
+    out << "  \"gpu_objects\": " << options.gpu_objects << ",\n";
+    out << "  \"total_s\": " << total_s << ",\n";
+    out << "  \"fps\": " << fps << ",\n";
+    out << "  \"ms\": {\n";
+    write_stats(out, "cpu_frame", cpu_frame_stats, false);
+    write_stats(out, "present_wait", present_wait_stats, false);
+    write_stats(out, "wait", wait_stats, false);
+    write_stats(out, "acquire", acquire_stats, false);
+    write_stats(out, "record", record_stats, false);
+    write_stats(out, "submit", submit_stats, false);
+    write_stats(out, "present", present_stats, true);
+    out << "  },\n";
+    out << "  \"host_allocations_per_frame\": {\"mean\": "
+        << host_allocations_stats.mean
+        << ", \"max\": " << host_allocations_stats.max
+        << ", \"bytes_mean\": " << host_allocated_bytes_stats.mean
+        << ", \"bytes_max\": " << host_allocated_bytes_stats.max << "},\n";
+    out << "  \"gpu_ms\": {\n";
+    for (size_t i = 0; i < gpu_timings.size(); ++i) {
+      out << "    \"" << gpu_timings[i].name
+          << "\": {\"mean\": " << gpu_timings[i].average_ms
+          << ", \"max\": " << gpu_timings[i].max_ms << "}"
+          << (i + 1 == gpu_timings.size() ? "" : ",") << "\n";
+    }
+    out << "  }\n";
+    out << "}\n";
+
+    std::cout << "Results written to " << options.output << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,2 +1,2 @@
-glslc shaders/shader.vert -o shaders/vert.spv
-glslc shaders/shader.frag -o shaders/frag.spv
+glslc shaders/shader.vert -o shaders/shader.vert.spv
+glslc shaders/shader.frag -o shaders/shader.frag.spv
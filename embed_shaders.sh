@@ -0,0 +1,51 @@
+#!/bin/sh
+# Embed SPIR-V files in a C++ source as `uint32_t` arrays (used by the
+# makefile). `name.spv` is registered as `name`, e.g. `shader.vert.spv` is
+# `get_shader("shader.vert")`.
+# Usage: ./embed_shaders.sh output.cpp file.spv...
+set -e
+
+output=$1
+shift
+
+# The lookup table is searched by name (binary search)
+files=$(for file in "$@"; do echo "$file"; done | LC_ALL=C sort)
+
+# `$files` is split on the newlines only (the paths may contain spaces), and
+# is not globbed
+IFS='
+'
+set -f
+
+{
+  echo "// Generated by embed_shaders.sh, do not edit"
+  echo "#include \"../../src/utils/shader/shader.hpp\""
+  echo ""
+  echo "namespace utils {"
+  echo "namespace shader {"
+
+  # `od` prints the words in the host byte order, the order expected by
+  # `vkCreateShaderModule`
+  i=0
+  for file in $files; do
+    echo "static constexpr uint32_t shader_$i[] = {"
+    od -An -v -tx4 "$file" | sed 's/ *\([0-9a-f]\{8\}\)/ 0x\1,/g; s/^/   /'
+    echo "};"
+    i=$((i + 1))
+  done
+
+  echo ""
+  echo "const EmbeddedShader embedded_shaders[] = {"
+  i=0
+  for file in $files; do
+    name=$(basename "$file" .spv)
+    echo "    {\"$name\", shader_$i, sizeof(shader_$i)},"
+    i=$((i + 1))
+  done
+  echo "    {nullptr, nullptr, 0},"
+  echo "};"
+  echo ""
+  echo "const size_t embedded_shader_count = $i;"
+  echo "} // namespace shader"
+  echo "} // namespace utils"
+} > "$output"
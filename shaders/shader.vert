@@ -1,20 +1,30 @@
 #version 450
 
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+// Per instance (identity for the draws of the draw list)
+layout(location = 2) in vec2 inInstanceTranslation;
+// Rotation (radians), scale
+layout(location = 3) in vec2 inInstanceRotationScale;
+
 layout(location = 0) out vec3 fragColor;
 
-vec2 positions[3] = vec2[](
-        vec2(0.0, -0.5),
-        vec2(0.5, 0.5),
-        vec2(-0.5, 0.5)
-    );
+// Written every frame in the uniform ring, bound with dynamic offsets
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 view_projection;
+} camera;
 
-vec3 colors[3] = vec3[](
-        vec3(1.0, 0.0, 0.0),
-        vec3(0.0, 1.0, 0.0),
-        vec3(0.0, 0.0, 1.0)
-    );
+layout(set = 0, binding = 1) uniform Object {
+    mat4 model;
+} object;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    float c = cos(inInstanceRotationScale.x);
+    float s = sin(inInstanceRotationScale.x);
+    vec2 position = mat2(c, s, -s, c) * inPosition * inInstanceRotationScale.y +
+                    inInstanceTranslation;
+
+    gl_Position = camera.view_projection * object.model *
+                  vec4(position, 0.0, 1.0);
+    fragColor = inColor;
 }
@@ -2,36 +2,85 @@
 
 #include "../utils/utils.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <exception>
 #include <iostream>
 
-/** Number of tasks that can be run in parallel */
-const int MAX_FRAMES_IN_FLIGHT = 2;
-uint32_t current_frame = 0;
+/** GPU passes timed with timestamp queries (a begin and an end query each) */
+enum GpuPass : uint32_t {
+  GPU_PASS_RENDER_PASS = 0,
+  GPU_PASS_DRAW,
+  GPU_PASS_CULL,
+  GPU_PASS_COUNT
+};
+const char *gpu_pass_names[GPU_PASS_COUNT] = {"render_pass", "draw", "cull"};
 
 /** Validation layers */
 extern const bool enable_validation_layer;
 
-std::vector<const char *> device_extensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-    VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME};
+/** Milliseconds elapsed since `start` */
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
 
 /** VLK */
 namespace lvk {
-Lvk::Lvk() {
-  // Inicializa a janela (GLFW)
-  this->init_glfw();
+Lvk::Lvk(Config config)
+    : config(config), capability_cache(config.capability_cache_path) {
+  if (this->config.frames_in_flight == 0) {
+    throw std::runtime_error("frames_in_flight must be at least 1");
+  }
+
+  utils::trace::set_verbose(this->config.verbose);
+  utils::trace::set_enabled(!this->config.trace_path.empty());
+  // Hot reload compiles into the directory of the shaders it loads (the
+  // makefile output by default)
+  if (this->config.hot_reload && this->config.shader_dir.empty()) {
+    this->config.shader_dir = "build/shaders";
+  }
+  utils::shader::set_shader_directory(this->config.shader_dir);
+
+  this->frames.resize(this->config.frames_in_flight);
+
+  // Host memory of the driver (`nullptr` = the driver's own allocator)
+  if (this->config.host_allocator) {
+    this->host_allocator =
+        std::make_unique<utils::allocator::HostAllocator>();
+    this->allocator = this->host_allocator->get_callbacks();
+  }
+
+  if (this->config.recording_threads > 0) {
+    this->recording_threads = std::make_unique<utils::thread_pool::ThreadPool>(
+        this->config.recording_threads);
+  }
+
+  this->device_extensions = {VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME};
 
-  // Inicializar as variaveis do `utils`
-  utils::extension::get_extensions();
-  utils::layer::get_layers();
+  // The swap chain is only needed to present to a window
+  if (!this->config.headless) {
+    this->device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+    // Inicializa a janela (GLFW)
+    this->init_glfw();
+  }
 
-  std::cout << "Lvk::init_vulkan()" << std::endl;
   this->init_vulkan();
+
+  // Cold start phases (everything above is done)
+  if (!this->config.trace_path.empty()) {
+    utils::trace::write_chrome_trace(this->config.trace_path);
+  }
 }
 
 void Lvk::init_glfw() {
+  utils::trace::Scope scope("Lvk::init_glfw");
+
   if (!glfwInit()) {
     throw std::runtime_error("Failed to initialize GLFW");
   }
@@ -39,51 +88,81 @@ void Lvk::init_glfw() {
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
   glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-  this->window = glfwCreateWindow(800, 600, "Vulkan window", nullptr, nullptr);
+  this->window = glfwCreateWindow(this->config.width, this->config.height,
+                                  "Vulkan window", nullptr, nullptr);
+
+  // Used to find the `Lvk` inside of the GLFW callbacks
+  glfwSetWindowUserPointer(this->window, this);
+  glfwSetFramebufferSizeCallback(this->window,
+                                 Lvk::framebuffer_resize_callback);
+}
+
+void Lvk::framebuffer_resize_callback(GLFWwindow *window, int width,
+                                      int height) {
+  (void)width;
+  (void)height;
+
+  auto lvk = reinterpret_cast<Lvk *>(glfwGetWindowUserPointer(window));
+  lvk->framebuffer_resized = true;
 }
 
 void Lvk::init_vulkan() {
-  std::cout << "\n\n\n -> Lvk::create_instance()" << std::endl;
-  this->create_instance();
+  utils::trace::Scope scope("Lvk::init_vulkan");
 
-  std::cout << "\n\n\n -> Lvk::create_debug_messenger()" << std::endl;
+  this->create_instance();
   this->create_debug_messenger();
-
-  std::cout << "\n\n\n -> Lvk::create_surface()" << std::endl;
   this->create_surface();
-
-  std::cout << "\n\n\n -> Lvk::pick_physical_device()" << std::endl;
   this->pick_physical_device();
-
-  std::cout << "\n\n\n -> Lvk::create_logical_device()" << std::endl;
   this->create_logical_device();
 
-  std::cout << "\n\n\n -> Lvk::create_swap_chain()" << std::endl;
-  this->create_swap_chain();
+  if (this->config.headless) {
+    this->create_offscreen_images();
+  } else {
+    this->create_swap_chain();
+  }
 
-  std::cout << "\n\n\n -> Lvk::create_image_views()" << std::endl;
   this->create_image_views();
-
-  std::cout << "\n\n\n -> Lvk::create_render_pass()" << std::endl;
+  this->create_pipeline_cache();
   this->create_render_pass();
-
-  std::cout << "\n\n\n -> Lvk::create_graphics_pipeline()" << std::endl;
+  this->create_descriptor_set_layout();
   this->create_graphics_pipeline();
+  this->create_culling_pass();
 
-  std::cout << "\n\n\n -> Lvk::create_framebuffers()" << std::endl;
-  this->create_framebuffers();
+  if (this->config.hot_reload) {
+    this->create_shader_watcher();
+  }
 
-  std::cout << "\n\n\n -> Lvk::create_command_pool()" << std::endl;
+  this->create_framebuffers();
   this->create_command_pool();
-
-  std::cout << "\n\n\n -> Lvk::create_command_buffer()" << std::endl;
   this->create_command_buffers();
+  this->create_staging_ring();
+
+  // Default scene (the draw list draws the mesh 0)
+  this->create_mesh({{{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+                     {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+                     {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}},
+                    {0, 1, 2});
+  // Drawn from the first frame
+  this->staging_ring->wait_for_batch(this->meshes[0].upload_batch);
+
+  if (this->recording_threads) {
+    this->create_worker_command_pools();
+  }
 
-  std::cout << "\n\n\n -> Lvk::create_sync_objects()" << std::endl;
   this->create_sync_objects();
+  this->create_query_pools();
+
+  if (this->config.cache_command_buffers) {
+    this->create_cached_command_buffers();
+  }
+
+  this->create_uniform_ring();
+  this->create_instance_buffer();
 }
 
 void Lvk::create_instance() {
+  utils::trace::Scope scope("Lvk::create_instance");
+
   /** Create the Application Info (optional) */
   VkApplicationInfo app_info{};
 
@@ -101,14 +180,20 @@ void Lvk::create_instance() {
   create_info.pApplicationInfo = &app_info;
 
   std::vector<const char *> extensions =
-      utils::extension::get_window_extensions();
+      this->config.headless ? utils::extension::get_headless_extensions()
+                            : utils::extension::get_window_extensions();
 
-  std::cout << "Extensions required by window:" << std::endl;
+  utils::trace::out() << "Extensions required by window:" << std::endl;
   for (const auto &extension : extensions) {
-    std::cout << "\t" << extension << std::endl;
+    utils::trace::out() << "\t" << extension << std::endl;
   }
 
-  if (!utils::extension::check_extensions(extensions)) {
+  // Enumerated by the loader, or read from the capability cache
+  const utils::capability::InstanceCapabilities &instance_capabilities =
+      this->capability_cache.get_instance();
+
+  if (!utils::extension::check_extensions(instance_capabilities.extensions,
+                                          extensions)) {
     throw std::runtime_error("Missing extensions");
   }
 
@@ -120,14 +205,15 @@ void Lvk::create_instance() {
       utils::layer::get_validation_layers();
 
   if (enable_validation_layer) {
-    std::cout << "Validation layers enabled" << std::endl;
+    utils::trace::out() << "Validation layers enabled" << std::endl;
 
-    std::cout << "Validation layers required:" << std::endl;
+    utils::trace::out() << "Validation layers required:" << std::endl;
     for (const auto &layer : validation_layers) {
-      std::cout << "\t" << layer << std::endl;
+      utils::trace::out() << "\t" << layer << std::endl;
     }
 
-    if (!utils::layer::check_validation_layers(validation_layers)) {
+    if (!utils::layer::check_validation_layers(instance_capabilities.layers,
+                                               validation_layers)) {
       throw std::runtime_error("Missing validation layers");
     }
 
@@ -135,17 +221,20 @@ void Lvk::create_instance() {
         static_cast<uint32_t>(validation_layers.size());
     create_info.ppEnabledLayerNames = validation_layers.data();
   } else {
-    std::cout << "Validation layers disabled" << std::endl;
+    utils::trace::out() << "Validation layers disabled" << std::endl;
     create_info.enabledLayerCount = 0;
   }
 
   /** Create the instance */
-  if (vkCreateInstance(&create_info, nullptr, &this->instance) != VK_SUCCESS) {
+  if (vkCreateInstance(&create_info, this->allocator, &this->instance) !=
+      VK_SUCCESS) {
     throw std::runtime_error("Failed to create Vulkan instance");
   }
 }
 
 void Lvk::create_debug_messenger() {
+  utils::trace::Scope scope("Lvk::create_debug_messenger");
+
   if (!enable_validation_layer) {
     return;
   }
@@ -154,29 +243,46 @@ void Lvk::create_debug_messenger() {
   create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
   create_info.messageSeverity =
       VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+      VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
       VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
       VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
   create_info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
                             VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
                             VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+  // Every severity is received, the logger filters them (can be changed at
+  // runtime, see `set_log_severity()`)
+  this->debug_logger = std::make_unique<utils::log::AsyncLogger>(
+      std::cerr, this->config.log_severity);
+
   create_info.pfnUserCallback = utils::messenger::debugCallback;
-  create_info.pUserData = nullptr;
+  create_info.pUserData = this->debug_logger.get();
 
   if (utils::messenger::create_debug_utils_messenger_ext(
-          instance, &create_info, nullptr, &this->debug_messenger) !=
+          instance, &create_info, this->allocator, &this->debug_messenger) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to set up debug messenger!");
   }
 }
 
 void Lvk::create_surface() {
-  if (glfwCreateWindowSurface(this->instance, window, nullptr,
+  utils::trace::Scope scope("Lvk::create_surface");
+
+  // Nothing is presented when headless, `VK_NULL_HANDLE` tells `utils` to skip
+  // the present support checks
+  if (this->config.headless) {
+    this->surface = VK_NULL_HANDLE;
+    return;
+  }
+
+  if (glfwCreateWindowSurface(this->instance, window, this->allocator,
                               &this->surface) != VK_SUCCESS) {
     throw std::runtime_error("failed to create window surface!");
   }
 }
 
 void Lvk::pick_physical_device() {
+  utils::trace::Scope scope("Lvk::pick_physical_device");
+
   uint32_t device_count = 0;
   vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
 
@@ -184,32 +290,92 @@ void Lvk::pick_physical_device() {
     throw std::runtime_error("failed to find GPUs with Vulkan support!");
   }
 
-  std::cout << "Number of physical devices: " << device_count << std::endl;
-
-  std::vector<VkPhysicalDevice> devices(device_count);
-  vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
-
-  for (const auto &device : devices) {
-    if (utils::device::is_device_suitable(device, this->surface,
-                                          device_extensions)) {
-      std::cout << "Device " << device << " suitable" << std::endl;
-      this->physical_device = device;
-      break;
-    }
+  // Everything the rest of `Lvk` needs from the device is queried here once
+  this->capabilities = utils::device::pick_best_device(
+      this->capability_cache, this->instance, this->surface,
+      this->device_extensions);
+  this->physical_device = this->capabilities.physical_device;
+
+  // Every device is enumerated, the next run reads them from the file. Best
+  // effort, the next run enumerates again.
+  try {
+    this->capability_cache.save();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
   }
 
   if (this->physical_device == VK_NULL_HANDLE) {
     throw std::runtime_error("failed to find a suitable GPU!");
   }
+
+  utils::trace::out() << "Device picked: "
+                      << this->capabilities.properties.deviceName
+                      << " (score " << this->capabilities.score << ")"
+                      << std::endl;
+
+  // Optional, the fences (and binary semaphores) are used without it
+  this->use_timeline_semaphore =
+      this->config.timeline_semaphore && this->capabilities.timeline_semaphore;
+  if (this->use_timeline_semaphore) {
+    this->device_extensions.push_back(
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  }
+
+  utils::trace::out() << "Timeline semaphore: " << this->use_timeline_semaphore
+                      << std::endl;
+
+  // Pacing on the displayed frames (nothing to pace for the max throughput)
+  this->use_present_wait =
+      !this->config.headless && this->config.max_queued_presents > 0 &&
+      this->config.present_policy !=
+          utils::swapchain::PresentPolicy::MAX_THROUGHPUT &&
+      this->capabilities.present_wait;
+  if (this->use_present_wait) {
+    this->device_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    this->device_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  }
+
+  utils::trace::out() << "Present wait: " << this->use_present_wait
+                      << std::endl;
+
+  // GPU-driven draws: every object of a mesh has a slot in one multi-draw,
+  // the culling writes the slot as the first instance
+  const VkPhysicalDeviceFeatures &features = this->capabilities.features;
+  uint32_t graphics_family =
+      this->capabilities.queue_family_indices.graphics_family.value();
+  this->use_gpu_culling =
+      features.multiDrawIndirect && features.drawIndirectFirstInstance &&
+      (this->capabilities.queue_families[graphics_family].queueFlags &
+       VK_QUEUE_COMPUTE_BIT);
+
+  // Optional, the culled slots are drawn empty without it
+  this->use_draw_indirect_count =
+      this->use_gpu_culling && this->capabilities.draw_indirect_count;
+  if (this->use_draw_indirect_count) {
+    this->device_extensions.push_back(
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+
+  utils::trace::out() << "GPU culling: " << this->use_gpu_culling
+                      << " (draw indirect count "
+                      << this->use_draw_indirect_count << ")" << std::endl;
 }
 
 void Lvk::create_logical_device() {
-  QueueFamilyIndices indices =
-      utils::queue::find_queue_families(this->physical_device, this->surface);
+  utils::trace::Scope scope("Lvk::create_logical_device");
+
+  const QueueFamilyIndices &indices = this->capabilities.queue_family_indices;
 
   std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-  std::set<uint32_t> unique_queue_families = {indices.graphics_family.value(),
-                                              indices.present_family.value()};
+  std::set<uint32_t> unique_queue_families = {indices.graphics_family.value()};
+  if (indices.present_family.has_value()) {
+    unique_queue_families.insert(indices.present_family.value());
+  }
+  bool use_transfer_queue =
+      this->config.transfer_queue && indices.transfer_family.has_value();
+  if (use_transfer_queue) {
+    unique_queue_families.insert(indices.transfer_family.value());
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : unique_queue_families) {
@@ -226,8 +392,11 @@ void Lvk::create_logical_device() {
   VkPhysicalDeviceFeatures device_features{};
   // Need to support `VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME`
   // https://docs.vulkan.org/spec/latest/appendices/extensions.html#VK_EXT_extended_dynamic_state3
-  // TODO: Add validation when picking the GPU.
+  // (checked by `utils::device::is_device_suitable`)
   device_features.fillModeNonSolid = VK_TRUE;
+  // Indirect draws of the culled objects
+  device_features.multiDrawIndirect = this->use_gpu_culling;
+  device_features.drawIndirectFirstInstance = this->use_gpu_culling;
 
   /** Create the logical device */
   VkDeviceCreateInfo create_info{};
@@ -239,21 +408,52 @@ void Lvk::create_logical_device() {
 
   create_info.pEnabledFeatures = &device_features;
 
+  // Features of the extensions are chained
+  void *features_chain = nullptr;
+
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features{};
+  timeline_semaphore_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  timeline_semaphore_features.timelineSemaphore = VK_TRUE;
+
+  if (this->use_timeline_semaphore) {
+    timeline_semaphore_features.pNext = features_chain;
+    features_chain = &timeline_semaphore_features;
+  }
+
+  VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+  present_id_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  present_id_features.presentId = VK_TRUE;
+
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+  present_wait_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  present_wait_features.presentWait = VK_TRUE;
+
+  if (this->use_present_wait) {
+    present_id_features.pNext = features_chain;
+    present_wait_features.pNext = &present_id_features;
+    features_chain = &present_wait_features;
+  }
+
+  create_info.pNext = features_chain;
+
   /** Device extension */
   // Dont need to be validated because we already checked it on
   // `is_device_suitable` when picking the physical device
-  std::cout << "Extensions enabled:" << std::endl;
-  for (const auto &extension : device_extensions) {
-    std::cout << "\t" << extension << std::endl;
+  utils::trace::out() << "Extensions enabled:" << std::endl;
+  for (const auto &extension : this->device_extensions) {
+    utils::trace::out() << "\t" << extension << std::endl;
   }
   create_info.enabledExtensionCount =
-      static_cast<uint32_t>(device_extensions.size());
-  create_info.ppEnabledExtensionNames = device_extensions.data();
+      static_cast<uint32_t>(this->device_extensions.size());
+  create_info.ppEnabledExtensionNames = this->device_extensions.data();
 
   /** Skip device specific validation layers because is deprecated (REF) */
   //
 
-  if (vkCreateDevice(this->physical_device, &create_info, nullptr,
+  if (vkCreateDevice(this->physical_device, &create_info, this->allocator,
                      &this->device) != VK_SUCCESS) {
     throw std::runtime_error("failed to create logical device!");
   }
@@ -261,14 +461,36 @@ void Lvk::create_logical_device() {
   /** Get the queue of the created device */
   vkGetDeviceQueue(device, indices.graphics_family.value(), 0,
                    &this->graphics_queue);
-  vkGetDeviceQueue(device, indices.present_family.value(), 0,
-                   &this->present_queue);
+  // Headless has no present queue
+  if (indices.present_family.has_value()) {
+    vkGetDeviceQueue(device, indices.present_family.value(), 0,
+                     &this->present_queue);
+  }
+  if (use_transfer_queue) {
+    vkGetDeviceQueue(device, indices.transfer_family.value(), 0,
+                     &this->transfer_queue);
+  }
+
+  utils::trace::out() << "Graphics queue: " << this->graphics_queue
+                      << std::endl;
+  utils::trace::out() << "Present queue: " << this->present_queue << std::endl;
+  utils::trace::out() << "Transfer queue: " << this->transfer_queue
+                      << std::endl;
 
-  std::cout << "Graphics queue: " << this->graphics_queue << std::endl;
-  std::cout << "Present queue: " << this->present_queue << std::endl;
+  if (this->use_present_wait) {
+    this->wait_for_present =
+        utils::swapchain::load_wait_for_present(this->device);
+  }
+
+  this->device_allocator = std::make_unique<utils::memory::DeviceAllocator>(
+      this->device, this->capabilities.memory_properties,
+      this->capabilities.properties.limits, this->allocator,
+      this->config.device_memory_block_size);
 }
 
-void Lvk::create_swap_chain() {
+void Lvk::create_swap_chain(VkSwapchainKHR old_swap_chain) {
+  utils::trace::Scope scope("Lvk::create_swap_chain");
+
   /** Creation of the swapchain */
   SwapChainSupportDetails swap_chain_support =
       utils::swapchain::query_swap_chain_support(this->surface,
@@ -277,21 +499,25 @@ void Lvk::create_swap_chain() {
   VkSurfaceFormatKHR surface_format =
       utils::swapchain::choose_swap_surface_format(swap_chain_support.formats);
   VkPresentModeKHR present_mode = utils::swapchain::choose_swap_present_mode(
-      swap_chain_support.present_modes);
+      swap_chain_support.present_modes, this->config.present_policy);
 
+  // Size in pixels (can differ from the window size on high DPI screens)
   int width, height;
-  glfwGetWindowSize(this->window, &width, &height);
+  glfwGetFramebufferSize(this->window, &width, &height);
 
   VkExtent2D extent = utils::swapchain::choose_swap_extent(
       swap_chain_support.capabilities, width, height);
 
   /** How many images we would like to have in the swap chain */
-  uint32_t image_count = swap_chain_support.capabilities.minImageCount + 1;
+  uint32_t image_count = utils::swapchain::choose_swap_image_count(
+      swap_chain_support.capabilities, present_mode,
+      this->config.present_policy);
 
-  if (swap_chain_support.capabilities.maxImageCount > 0 &&
-      image_count > swap_chain_support.capabilities.maxImageCount) {
-    image_count = swap_chain_support.capabilities.maxImageCount;
-  }
+  utils::trace::out() << "Present policy: "
+                      << utils::swapchain::present_policy_name(
+                             this->config.present_policy)
+                      << " (present mode " << present_mode << ", "
+                      << image_count << " images)" << std::endl;
 
   /** Creation of the structure */
   VkSwapchainCreateInfoKHR create_info{};
@@ -305,8 +531,7 @@ void Lvk::create_swap_chain() {
   create_info.imageArrayLayers = 1;
   create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-  QueueFamilyIndices indices =
-      utils::queue::find_queue_families(this->physical_device, this->surface);
+  const QueueFamilyIndices &indices = this->capabilities.queue_family_indices;
   uint32_t queue_family_indices[] = {indices.graphics_family.value(),
                                      indices.present_family.value()};
 
@@ -333,9 +558,11 @@ void Lvk::create_swap_chain() {
   create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   create_info.presentMode = present_mode;
   create_info.clipped = VK_TRUE;
-  create_info.oldSwapchain = VK_NULL_HANDLE;
+  // When recreating, the old swap chain is handed over so the driver can reuse
+  // its resources and keep presenting the images already acquired from it
+  create_info.oldSwapchain = old_swap_chain;
 
-  if (vkCreateSwapchainKHR(this->device, &create_info, nullptr,
+  if (vkCreateSwapchainKHR(this->device, &create_info, this->allocator,
                            &this->swap_chain) != VK_SUCCESS) {
     throw std::runtime_error("failed to create swap chain!");
   }
@@ -350,9 +577,134 @@ void Lvk::create_swap_chain() {
 
   this->swap_chain_image_format = surface_format.format;
   this->swap_chain_extent = extent;
+
+  // Present ids restart with the swap chain: the next frame is the first one
+  this->first_present_id = this->submitted_frames + 1;
+}
+
+void Lvk::recreate_swap_chain() {
+  // A minimized window has no size, nothing can be presented until it is
+  // restored
+  int width = 0, height = 0;
+  glfwGetFramebufferSize(this->window, &width, &height);
+  while (width == 0 || height == 0) {
+    glfwWaitEvents();
+    glfwGetFramebufferSize(this->window, &width, &height);
+  }
+
+  VkSwapchainKHR old_swap_chain = this->swap_chain;
+  std::vector<VkImageView> old_image_views =
+      std::move(this->swap_chain_image_views);
+  std::vector<VkFramebuffer> old_framebuffers =
+      std::move(this->swap_chain_framebuffers);
+
+  // The surface format is picked the same way from the same surface, so the
+  // render pass (and the pipeline) are still compatible and are kept
+  this->create_swap_chain(old_swap_chain);
+  this->create_image_views();
+  this->create_framebuffers();
+
+  // The cached command buffers draw into the old framebuffers (and the number
+  // of images may have changed), new ones are recorded on demand
+  std::vector<CachedCommandBuffer> old_cached_command_buffers =
+      std::move(this->cached_command_buffers);
+  if (this->config.cache_command_buffers) {
+    this->create_cached_command_buffers();
+  }
+
+  // The cached command buffers use the uniform and instance regions of their
+  // image: the regions change if the number of images changed
+  if (this->config.cache_command_buffers &&
+      this->uniform_ring->get_region_count() !=
+          this->get_frame_region_count()) {
+    std::shared_ptr<utils::uniform::UniformRing> old_uniform_ring =
+        std::move(this->uniform_ring);
+    std::shared_ptr<utils::instance::InstanceBuffer> old_instance_buffer =
+        std::move(this->instance_buffer);
+    VkDevice device = this->device;
+    VkDescriptorPool old_descriptor_pool = this->descriptor_pool;
+    const VkAllocationCallbacks *allocator = this->allocator;
+    this->retire([device, old_uniform_ring, old_instance_buffer,
+                  old_descriptor_pool, allocator]() mutable {
+      vkDestroyDescriptorPool(device, old_descriptor_pool, allocator);
+      old_uniform_ring.reset();
+      old_instance_buffer.reset();
+    });
+
+    this->create_uniform_ring();
+    this->create_instance_buffer();
+  }
+
+  // Frames in flight can still be rendering to (or presenting) the old images.
+  // Their fences don't cover the presents still queued on the old swap chain:
+  // it is destroyed one full frame cycle later.
+  VkDevice device = this->device;
+  VkCommandPool command_pool = this->command_pool;
+  const VkAllocationCallbacks *allocator = this->allocator;
+  auto destroy = [device, command_pool, allocator, old_swap_chain,
+                  old_image_views, old_framebuffers,
+                  old_cached_command_buffers]() {
+    for (const auto &cached : old_cached_command_buffers) {
+      vkFreeCommandBuffers(device, command_pool, 1, &cached.command_buffer);
+
+      if (cached.query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, cached.query_pool, allocator);
+      }
+    }
+
+    for (auto framebuffer : old_framebuffers) {
+      vkDestroyFramebuffer(device, framebuffer, allocator);
+    }
+
+    for (auto image_view : old_image_views) {
+      vkDestroyImageView(device, image_view, allocator);
+    }
+
+    vkDestroySwapchainKHR(device, old_swap_chain, allocator);
+  };
+  this->retire(std::move(destroy), this->frames.size());
+}
+
+void Lvk::create_offscreen_images() {
+  utils::trace::Scope scope("Lvk::create_offscreen_images");
+
+  // One image per frame in flight: the frame `i` always renders into the image
+  // `i`, so the `in_flight_fence` of the frame also protects its image
+  this->swap_chain_images.resize(this->frames.size());
+  this->offscreen_images.resize(this->frames.size());
+
+  this->swap_chain_image_format = VK_FORMAT_B8G8R8A8_SRGB;
+  this->swap_chain_extent = {this->config.width, this->config.height};
+
+  for (size_t i = 0; i < this->swap_chain_images.size(); ++i) {
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = this->swap_chain_image_format;
+    image_info.extent.width = this->swap_chain_extent.width;
+    image_info.extent.height = this->swap_chain_extent.height;
+    image_info.extent.depth = 1;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    // Optimal tiling, the image is only read back through a copy
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    // Rendered as a color attachment and can be copied out (readback)
+    image_info.usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    // Suballocated: the images of all the frames share a memory block
+    this->offscreen_images[i] = this->device_allocator->create_image(
+        image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    this->swap_chain_images[i] = this->offscreen_images[i].image;
+  }
 }
 
 void Lvk::create_image_views() {
+  utils::trace::Scope scope("Lvk::create_image_views");
+
   this->swap_chain_image_views.resize(this->swap_chain_images.size());
 
   for (size_t i = 0; i < this->swap_chain_image_views.size(); i++) {
@@ -380,14 +732,31 @@ void Lvk::create_image_views() {
     create_info.subresourceRange.baseArrayLayer = 0;
     create_info.subresourceRange.layerCount = 1;
 
-    if (vkCreateImageView(device, &create_info, nullptr,
+    if (vkCreateImageView(device, &create_info, this->allocator,
                           &this->swap_chain_image_views[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create image views!");
     }
   }
 }
 
+void Lvk::create_pipeline_cache() {
+  utils::trace::Scope scope("Lvk::create_pipeline_cache");
+
+  // Without a directory the pipelines are compiled without cache
+  if (this->config.pipeline_cache_dir.empty()) {
+    return;
+  }
+
+  this->pipeline_cache_path = utils::pipeline_cache::get_pipeline_cache_path(
+      this->capabilities.properties, this->config.pipeline_cache_dir);
+  this->pipeline_cache = utils::pipeline_cache::load_pipeline_cache(
+      this->device, this->capabilities.properties, this->pipeline_cache_path,
+      this->allocator);
+}
+
 void Lvk::create_render_pass() {
+  utils::trace::Scope scope("Lvk::create_render_pass");
+
   /** Attachment Description */
   // Describres the framebuffer attachments that will be used while rendering:
   //  - How many color and depth buffers there will be;
@@ -443,8 +812,11 @@ void Lvk::create_render_pass() {
 
   // We want the image to be ready for presentation using the swap chain after
   // rendering, which is why we use `VK_IMAGE_LAYOUT_PRESENT_SRC_KHR` as
-  // finalLayout.
-  color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  // finalLayout. Offscreen images are never presented, they are left ready to
+  // be copied out instead.
+  color_attachment.finalLayout = this->config.headless
+                                     ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                     : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
   /** Color attachment reference */
   // Subpass references one or more of the attachments that we've
@@ -486,274 +858,77 @@ void Lvk::create_render_pass() {
   render_pass_info.subpassCount = 1;
   render_pass_info.pSubpasses = &subpass;
 
-  if (vkCreateRenderPass(device, &render_pass_info, nullptr,
+  if (vkCreateRenderPass(device, &render_pass_info, this->allocator,
                          &this->render_pass) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
 }
 
 void Lvk::create_graphics_pipeline() {
-  /** Read the shaders */
-  std::vector<char> vert_shader_code =
-      utils::file::read_file("shaders/vert.spv");
-  std::vector<char> frag_shader_code =
-      utils::file::read_file("shaders/frag.spv");
-
-  /** Create the shaders module */
-  VkShaderModule vert_shader_module = create_shader_module(vert_shader_code);
-  VkShaderModule frag_shader_module = create_shader_module(frag_shader_code);
-
-  /** Create the vertex shader */
-  VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
-  vert_shader_stage_info.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT; // vertex shader
-  vert_shader_stage_info.module = vert_shader_module;
-  vert_shader_stage_info.pName = "main";
-
-  /** Create the frag shader */
-  VkPipelineShaderStageCreateInfo frag_shader_stage_info{};
-  frag_shader_stage_info.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  frag_shader_stage_info.stage =
-      VK_SHADER_STAGE_FRAGMENT_BIT; // fragment shader
-  frag_shader_stage_info.module = frag_shader_module;
-  frag_shader_stage_info.pName = "main";
-
-  /** Shader stages */
-  std::vector<VkPipelineShaderStageCreateInfo> shader_stages = {
-      vert_shader_stage_info, frag_shader_stage_info};
-
-  /****************** */
-  /** Fixed functions */
-  /****************** */
-  // Image of the pipeline:
-  // https://vulkan-tutorial.com/images/vulkan_simplified_pipeline.svg
-
-  /** Vertex input */
-  // Fixed for now because the vertex are written directly in the shader
-  // Will be modified on:
-  // https://vulkan-tutorial.com/Vertex_buffers/Vertex_input_description
-  VkPipelineVertexInputStateCreateInfo vertex_input_info{};
-  vertex_input_info.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertex_input_info.vertexBindingDescriptionCount = 0;
-  vertex_input_info.pVertexBindingDescriptions = nullptr; // Optional
-  vertex_input_info.vertexAttributeDescriptionCount = 0;
-  vertex_input_info.pVertexAttributeDescriptions = nullptr; // Optional
-
-  /** Input assembly */
-  // Input assembly describe two things:
-  //  - what kind of geometry will be drawn from the vertices (topology);
-  //  - primitive restart enable or not (primitiveRestartEnable)
-  //    - This enable break the topology of _STRIP modes by using a special
-  //      index of 0xFFFF or 0xFFFFFFFF.
-  VkPipelineInputAssemblyStateCreateInfo input_assembly{};
-  input_assembly.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
-  input_assembly.primitiveRestartEnable = VK_FALSE;
-
-  /** Dynamic state - set some variables that can be dynamic in the pipeline */
-  // If we want to change some variable that can be modified without recreating
-  // the pipeline, we can specify here. This will cause the configuration of
-  // these values to be ignored and required to specify the data at drawing
-  // time.
-
-  // States that can be modified:
-  // https://registry.khronos.org/vulkan/specs/latest/man/html/VkDynamicState.html
-  std::vector<VkDynamicState> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT,
-                                                VK_DYNAMIC_STATE_SCISSOR};
-
-  VkPipelineDynamicStateCreateInfo dynamic_state{};
-  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamic_state.dynamicStateCount =
-      static_cast<uint32_t>(dynamic_states.size());
-  dynamic_state.pDynamicStates = dynamic_states.data();
-
-  /** Viewport and Scissor */
-  // Viewport(s) and scissor rectangle(s) can either be specified as a static
-  // part of the pipeline or as a dynamic state set in the command buffer, if
-  // not set to dynamic state, they need to be declared here and passed into the
-  // ViewportState.
-
-  /** Without dynamic state
-    // Viewport
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) this->swap_chain_extent.width;
-    viewport.height = (float) this->swap_chain_extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    // Scissor
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = this->swap_chain_extent;
-  */
-
-  /** If used in the dynamic state, they will be set up at drawing time */
-  VkPipelineViewportStateCreateInfo viewport_state{};
-  viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewport_state.viewportCount = 1;
-  // viewport_state.pViewports = &viewport; // Without dynamic state
-  viewport_state.scissorCount = 1;
-  // viewport_state.pScissors = &scissor; // // Without dynamic state
-
-  /** Rasterizer */
-  // Takes the geometry that is shaped by the vertices from the vertex shader
-  // and turns it into fragments to be colored by the fragment shader. Also
-  // performs:
-  //  - Depth testing
-  //  - Face culling
-  //  - Scissor test
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  // Discart all the geometry (no fragments are generated)
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  // How fragments are generated for geometry (other mode than
-  // `VK_POLYGON_MODE_FILL` requires enabling a GPU feature)
-  // Ref of the polygonModes:
-  // https://registry.khronos.org/vulkan/specs/latest/man/html/VkPolygonMode.html
-  // List of common used:
-  //  - VK_POLYGON_MODE_FILL
-  //  - VK_POLYGON_MODE_LINE
-  //  - VK_POLYGON_MODE_POINT
-  // rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.polygonMode = VK_POLYGON_MODE_LINE; // Example using wireframe
-
-  // If `lineWidth > 1.0f` need to enable feature `wideLines`
-  rasterizer.lineWidth = 1.0f;
-
-  // Cull mode and front face (Specify what face to be cull and the orientation
-  // to be considered Front and Back face)
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-
-  // Don't used for now
-  // https://vulkan-tutorial.com/en/Drawing_a_triangle/Graphics_pipeline_basics/Fixed_functions
-  //  - Last topic of Rasterizer
-  rasterizer.depthBiasEnable = VK_FALSE;
-  rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-  rasterizer.depthBiasClamp = 0.0f;          // Optional
-  rasterizer.depthBiasSlopeFactor = 0.0f;    // Optional
-
-  /** Multisampling */
-  // Combine the fragment shader results of multiple polygons that rasterize to
-  // the same pixel (requires enabling a GPU feature).
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-  multisampling.minSampleShading = 1.0f;          // Optional
-  multisampling.pSampleMask = nullptr;            // Optional
-  multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-  multisampling.alphaToOneEnable = VK_FALSE;      // Optional
-
-  /** Color blending */
-  // After a fragment shader has returned a color, it combined with the color
-  // that is already in the framebuffer
-
-  // Configuration per attached framebuffer
-  VkPipelineColorBlendAttachmentState color_blend_attachment{};
-  // No blending
-  color_blend_attachment.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  // If set to true, it will apply a mask based on the `colorWriteMask` channels
-  // of the framebuffer.
-  // This are commonly used using oppacity (like glass or something like that)
-
-  // Example: This blending mode ignore whatever is in the framebuffer and just
-  // write the fragment color directly to the framebuffer.
-  color_blend_attachment.blendEnable = VK_TRUE;                      // Disabled
-  color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
-  color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-  color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;             // Optional
-  color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
-  color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-  color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;             // Optional
-
-  // Global color blending settings
-  VkPipelineColorBlendStateCreateInfo color_blending{};
-  color_blending.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  color_blending.logicOpEnable = VK_FALSE;
-  color_blending.logicOp = VK_LOGIC_OP_COPY; // Optional
-
-  color_blending.attachmentCount = 1;
-  color_blending.pAttachments = &color_blend_attachment;
-
-  color_blending.blendConstants[0] = 0.0f; // Optional
-  color_blending.blendConstants[1] = 0.0f; // Optional
-  color_blending.blendConstants[2] = 0.0f; // Optional
-  color_blending.blendConstants[3] = 0.0f; // Optional
+  utils::trace::Scope scope("Lvk::create_graphics_pipeline");
 
   /** Pipeline layout */
   // The uniform values in the `shaders` need to be specified during pipeline
   // creation by creating a VkPipelineLayout object.
-  // TODO: Set to a custom pipeline layout based on the shaders that will be
-  // used.
   VkPipelineLayoutCreateInfo pipeline_layout_info{};
   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipeline_layout_info.setLayoutCount = 0;            // Optional
-  pipeline_layout_info.pSetLayouts = nullptr;         // Optional
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts = &this->descriptor_set_layout;
   pipeline_layout_info.pushConstantRangeCount = 0;    // Optional
   pipeline_layout_info.pPushConstantRanges = nullptr; // Optional
 
-  if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr,
+  if (vkCreatePipelineLayout(device, &pipeline_layout_info, this->allocator,
                              &this->pipeline_layout) != VK_SUCCESS) {
     throw std::runtime_error("failed to create pipeline layout!");
   }
 
   /** Pipeline */
-  //
-  VkGraphicsPipelineCreateInfo pipeline_info{};
-  pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-  // Shader stages
-  pipeline_info.stageCount = static_cast<uint32_t>(shader_stages.size());
-  pipeline_info.pStages = shader_stages.data();
-
-  // Fixed function stage
-  pipeline_info.pVertexInputState = &vertex_input_info;
-  pipeline_info.pInputAssemblyState = &input_assembly;
-  pipeline_info.pViewportState = &viewport_state;
-  pipeline_info.pRasterizationState = &rasterizer;
-  pipeline_info.pMultisampleState = &multisampling;
-  pipeline_info.pDepthStencilState = nullptr; // Optional
-  pipeline_info.pColorBlendState = &color_blending;
-  pipeline_info.pDynamicState = &dynamic_state;
-
-  // Pipeline layout
-  pipeline_info.layout = this->pipeline_layout;
-
-  // Render pass
-  // Define the index of the sub pass where this graphics pipeline will be used
-  // based on the `render_pass`.
-  pipeline_info.renderPass = this->render_pass;
-  pipeline_info.subpass = 0;
-
-  // Pipeline derivatives
-  // Used to create a new pipeline by deriving from an existing pipeline.
-  pipeline_info.basePipelineHandle = VK_NULL_HANDLE; // Optional
-  pipeline_info.basePipelineIndex = -1;              // Optional
-
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info,
-                                nullptr,
-                                &this->graphics_pipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
+  // Kept to compile the pipeline again when its shaders change
+  utils::pipeline::GraphicsPipelineDescription &description =
+      this->graphics_pipeline_description;
+  description.name = "default";
+  description.vertex_shader = "shader.vert";
+  description.fragment_shader = "shader.frag";
+  description.vertex_format.stride = sizeof(Vertex);
+  description.vertex_format.attributes = {
+      {0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, position)},
+      {1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)}};
+  description.vertex_format.instance_stride = sizeof(Instance);
+  description.vertex_format.instance_attributes = {
+      {2, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, translation)},
+      {3, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, rotation)}};
+  description.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  description.polygon_mode = VK_POLYGON_MODE_LINE; // Example using wireframe
+  description.cull_mode = VK_CULL_MODE_BACK_BIT;
+  description.front_face = VK_FRONT_FACE_CLOCKWISE;
+  description.blend_enable = VK_TRUE;
+  description.layout = this->pipeline_layout;
+  description.render_pass = this->render_pass;
+
+  this->pipeline_builder = std::make_unique<utils::pipeline::PipelineBuilder>(
+      this->device, this->pipeline_cache,
+      this->config.pipeline_compile_threads, this->allocator);
+
+  // Without workers the optimized pipeline is compiled right away
+  if (this->pipeline_builder->thread_count() == 0) {
+    this->graphics_pipeline = this->pipeline_builder->build(description);
+    return;
   }
 
-  /** Destroy the shaders when the pipeline is created */
-  vkDestroyShaderModule(this->device, vert_shader_module, nullptr);
-  vkDestroyShaderModule(this->device, frag_shader_module, nullptr);
+  // Unoptimized placeholder drawn until the workers are done with the real
+  // pipeline (swapped by `update_pipelines()`)
+  utils::pipeline::GraphicsPipelineDescription placeholder = description;
+  placeholder.name = "default (placeholder)";
+  placeholder.disable_optimization = true;
+  this->graphics_pipeline = this->pipeline_builder->build(placeholder);
+
+  this->pending_graphics_pipeline =
+      this->pipeline_builder->submit(description);
 }
 
 void Lvk::create_framebuffers() {
+  utils::trace::Scope scope("Lvk::create_framebuffers");
+
   // Resize the framebuffer to fit all the image views
   this->swap_chain_framebuffers.resize(this->swap_chain_image_views.size());
 
@@ -773,7 +948,7 @@ void Lvk::create_framebuffers() {
     // Refer to the number of layers in image arrays.
     framebuffer_info.layers = 1;
 
-    if (vkCreateFramebuffer(device, &framebuffer_info, nullptr,
+    if (vkCreateFramebuffer(device, &framebuffer_info, this->allocator,
                             &this->swap_chain_framebuffers[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create framebuffer!");
     }
@@ -781,8 +956,10 @@ void Lvk::create_framebuffers() {
 }
 
 void Lvk::create_command_pool() {
-  QueueFamilyIndices queue_family_indices =
-      utils::queue::find_queue_families(this->physical_device, this->surface);
+  utils::trace::Scope scope("Lvk::create_command_pool");
+
+  const QueueFamilyIndices &queue_family_indices =
+      this->capabilities.queue_family_indices;
 
   VkCommandPoolCreateInfo pool_info{};
   pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -806,14 +983,16 @@ void Lvk::create_command_pool() {
   // graphics queue family.
   pool_info.queueFamilyIndex = queue_family_indices.graphics_family.value();
 
-  if (vkCreateCommandPool(device, &pool_info, nullptr, &this->command_pool) !=
-      VK_SUCCESS) {
+  if (vkCreateCommandPool(device, &pool_info, this->allocator,
+                          &this->command_pool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
 }
 
 void Lvk::create_command_buffers() {
-  this->command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+  utils::trace::Scope scope("Lvk::create_command_buffers");
+
+  std::vector<VkCommandBuffer> command_buffers(this->frames.size());
 
   //
   VkCommandBufferAllocateInfo alloc_info{};
@@ -828,20 +1007,27 @@ void Lvk::create_command_buffers() {
   //    be called from primary command buffers.
   alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
   alloc_info.commandBufferCount =
-      static_cast<uint32_t>(this->command_buffers.size());
+      static_cast<uint32_t>(command_buffers.size());
 
-  if (vkAllocateCommandBuffers(device, &alloc_info,
-                               this->command_buffers.data()) != VK_SUCCESS) {
+  if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers.data()) !=
+      VK_SUCCESS) {
     throw std::runtime_error("failed to allocate command buffers!");
   }
+
+  // One command buffer per frame in flight
+  for (size_t i = 0; i < this->frames.size(); ++i) {
+    this->frames[i].command_buffer = command_buffers[i];
+  }
 }
 
 /** Writes the commands we want to execute into a command buffer. */
 // Set the  process of recording the command buffer Begin Command Buffer
 // -> Begin Render Pass -> Bind Pipeline -> Draw -> End Rebder Pass -> End
 // Command Buffer
-void Lvk::record_command_buffer(VkCommandBuffer command_buffer,
-                                uint32_t image_index) {
+void Lvk::record_command_buffer(
+    VkCommandBuffer command_buffer, uint32_t image_index,
+    VkQueryPool query_pool,
+    const std::vector<VkCommandBuffer> &secondary_command_buffers) {
   // Start the Command Buffer
   // Will implicitly reset the `VkCommandBuffer`
   VkCommandBufferBeginInfo begin_info{};
@@ -851,6 +1037,29 @@ void Lvk::record_command_buffer(VkCommandBuffer command_buffer,
     throw std::runtime_error("failed to begin recording command buffer!");
   }
 
+  // Queries must be reset before being written (outside of the render pass)
+  if (query_pool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(command_buffer, query_pool, 0, GPU_PASS_COUNT * 2);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        query_pool, GPU_PASS_RENDER_PASS * 2);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        query_pool, GPU_PASS_CULL * 2);
+  }
+
+  // The GPU-driven draws of the render pass read the outputs of the culling
+  // (compute, outside of the render pass)
+  if (this->is_culling_scene_ready()) {
+    uint32_t dynamic_offsets[] = {this->camera_offset,
+                                  this->instanced_object_offset};
+    this->culling_pass->record_cull(command_buffer, *this->culling_scene,
+                                    this->descriptor_set, dynamic_offsets);
+  }
+
+  if (query_pool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        query_pool, GPU_PASS_CULL * 2 + 1);
+  }
+
   // Start the render pass
   VkRenderPassBeginInfo render_pass_info{};
   render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -870,9 +1079,55 @@ void Lvk::record_command_buffer(VkCommandBuffer command_buffer,
   // Start the Cmd
   // After beginning a render pass instance, the command buffer is ready to
   // record the commands for the first subpass of that render pass.
-  vkCmdBeginRenderPass(command_buffer, &render_pass_info,
-                       VK_SUBPASS_CONTENTS_INLINE);
+  //  - VK_SUBPASS_CONTENTS_INLINE: The commands are recorded in this (primary)
+  //    command buffer;
+  //  - VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: The commands are
+  //    executed from secondary command buffers (the only thing the primary
+  //    can do in the subpass).
+  if (secondary_command_buffers.empty()) {
+    vkCmdBeginRenderPass(command_buffer, &render_pass_info,
+                         VK_SUBPASS_CONTENTS_INLINE);
+
+    if (query_pool != VK_NULL_HANDLE) {
+      vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          query_pool, GPU_PASS_DRAW * 2);
+    }
+
+    this->record_draws(command_buffer, 0, this->get_draw_count());
+
+    if (query_pool != VK_NULL_HANDLE) {
+      vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          query_pool, GPU_PASS_DRAW * 2 + 1);
+    }
+  } else {
+    vkCmdBeginRenderPass(command_buffer, &render_pass_info,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    // The draw timestamps are written by the first and last secondary
+    vkCmdExecuteCommands(command_buffer,
+                         static_cast<uint32_t>(secondary_command_buffers.size()),
+                         secondary_command_buffers.data());
+  }
+
+  // End the render pass
+  vkCmdEndRenderPass(command_buffer);
+
+  if (query_pool != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        query_pool, GPU_PASS_RENDER_PASS * 2 + 1);
+  }
+
+  // End the command buffer
+  if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+}
 
+/** Draws `count` commands of the draw list starting at `first` */
+// The pipeline and the dynamic state are not inherited by secondary command
+// buffers, so they are set with every slice.
+void Lvk::record_draws(VkCommandBuffer command_buffer, size_t first,
+                       size_t count) {
   // Bind the graphics pipeline with the command buffer
   vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     this->graphics_pipeline);
@@ -892,31 +1147,230 @@ void Lvk::record_command_buffer(VkCommandBuffer command_buffer,
   scissor.extent = this->swap_chain_extent;
   vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-  // Execute the draw command
+  // Execute the draw commands
 
-  //  - vertexCount: Specify how many vertices have to draw. (3 hardcoded).
+  //  - indexCount: Specify how many indices have to draw.
   //  - instanceCount: Used for instanced rendering. (1 if not doing that).
-  //  - firstVertex: Offset into the vertex buffer, defines the
-  //    lowest value of gl_VertexIndex.
+  //  - firstIndex: Offset into the index buffer.
+  //  - vertexOffset: Added to the indices before reading the vertices.
   //  - firstInstance: Offset for instanced rendering, defines the
   //    lowest value of gl_InstanceIndex.
-  vkCmdDraw(command_buffer, 3, 1, 0, 0);
+  // Every draw reads its instances from the same buffer (binding 1)
+  VkBuffer instance_buffer = this->instance_buffer->get_buffer();
+  VkDeviceSize instance_offset = 0;
+  vkCmdBindVertexBuffers(command_buffer, 1, 1, &instance_buffer,
+                         &instance_offset);
+
+  // The buffers are only bound again when the mesh changes
+  uint32_t bound_mesh = UINT32_MAX;
+  DrawCommand instanced_draw;
+  size_t gpu_draws_start =
+      this->draw_list.size() + this->instance_draws.size();
+  for (size_t i = first; i < first + count; ++i) {
+    // The GPU-driven draws come last, with the culled instances
+    if (i >= gpu_draws_start) {
+      uint32_t mesh_index = this->gpu_draw_meshes[i - gpu_draws_start];
+      const utils::mesh::Mesh &mesh = this->meshes.at(mesh_index);
+
+      if (mesh.upload_batch > this->ready_upload_batch) {
+        continue;
+      }
+
+      uint32_t dynamic_offsets[] = {this->camera_offset,
+                                    this->instanced_object_offset};
+      vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              this->pipeline_layout, 0, 1,
+                              &this->descriptor_set, 2, dynamic_offsets);
+
+      if (mesh_index != bound_mesh) {
+        utils::mesh::bind_mesh(command_buffer, mesh);
+        bound_mesh = mesh_index;
+      }
+
+      if (instance_buffer != this->culling_scene->instances.buffer) {
+        instance_buffer = this->culling_scene->instances.buffer;
+        vkCmdBindVertexBuffers(command_buffer, 1, 1, &instance_buffer,
+                               &instance_offset);
+      }
+
+      this->culling_pass->record_draws(command_buffer, *this->culling_scene,
+                                       mesh_index);
+      continue;
+    }
 
-  // End the render pass
-  vkCmdEndRenderPass(command_buffer);
+    // The instanced draws come after the draw list
+    const DrawCommand *draw = &instanced_draw;
+    uint32_t object_offset = this->instanced_object_offset;
+    if (i < this->draw_list.size()) {
+      draw = &this->draw_list[i];
+      object_offset = this->object_offsets[i];
+    } else {
+      const InstanceDraw &instances =
+          this->instance_draws[i - this->draw_list.size()];
+      instanced_draw.mesh = instances.mesh;
+      instanced_draw.instance_count = instances.instance_count;
+      instanced_draw.first_instance = instances.first_instance;
+    }
 
-  // End the command buffer
-  if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to record command buffer!");
+    const utils::mesh::Mesh &mesh = this->meshes.at(draw->mesh);
+
+    // Still uploading
+    if (mesh.upload_batch > this->ready_upload_batch) {
+      continue;
+    }
+
+    // Camera and transform of the draw, written by `write_uniforms()`
+    uint32_t dynamic_offsets[] = {this->camera_offset, object_offset};
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            this->pipeline_layout, 0, 1,
+                            &this->descriptor_set, 2, dynamic_offsets);
+
+    if (draw->mesh != bound_mesh) {
+      utils::mesh::bind_mesh(command_buffer, mesh);
+      bound_mesh = draw->mesh;
+    }
+
+    uint32_t index_count =
+        draw->index_count == 0 ? mesh.index_count : draw->index_count;
+    vkCmdDrawIndexed(command_buffer, index_count, draw->instance_count,
+                     draw->first_index, draw->vertex_offset,
+                     draw->first_instance);
+  }
+}
+
+std::vector<VkCommandBuffer>
+Lvk::record_secondary_command_buffers(FrameContext &frame,
+                                      uint32_t image_index,
+                                      VkQueryPool query_pool) {
+  // Contiguous slices of the draw list, at most one per worker (and none
+  // empty)
+  size_t draw_count = this->get_draw_count();
+  size_t slice_count =
+      std::min(draw_count, frame.secondary_command_buffers.size());
+
+  std::vector<VkCommandBuffer> secondary_command_buffers(
+      frame.secondary_command_buffers.begin(),
+      frame.secondary_command_buffers.begin() + slice_count);
+
+  std::vector<std::future<void>> jobs;
+
+  for (size_t slice = 0; slice < slice_count; ++slice) {
+    size_t first = draw_count * slice / slice_count;
+    size_t count = draw_count * (slice + 1) / slice_count - first;
+
+    // Each slice has its own pool (there are at most as many slices as
+    // workers), only the job recording the slice uses it
+    jobs.push_back(this->recording_threads->submit([this, &frame, slice,
+                                                    slice_count, first, count,
+                                                    image_index, query_pool]() {
+      VkCommandBuffer command_buffer = frame.secondary_command_buffers[slice];
+
+      // Faster than resetting the command buffers one by one
+      vkResetCommandPool(this->device, frame.worker_command_pools[slice], 0);
+
+      // The secondary continues the render pass (subpass 0) of the primary
+      VkCommandBufferInheritanceInfo inheritance_info{};
+      inheritance_info.sType =
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+      inheritance_info.renderPass = this->render_pass;
+      inheritance_info.subpass = 0;
+      inheritance_info.framebuffer =
+          this->swap_chain_framebuffers[image_index];
+
+      VkCommandBufferBeginInfo begin_info{};
+      begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      begin_info.pInheritanceInfo = &inheritance_info;
+
+      if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error(
+            "failed to begin recording secondary command buffer!");
+      }
+
+      // The secondaries are executed in order, the draws start in the first
+      // one and end in the last one
+      if (query_pool != VK_NULL_HANDLE && slice == 0) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            query_pool, GPU_PASS_DRAW * 2);
+      }
+
+      this->record_draws(command_buffer, first, count);
+
+      if (query_pool != VK_NULL_HANDLE && slice == slice_count - 1) {
+        vkCmdWriteTimestamp(command_buffer,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool,
+                            GPU_PASS_DRAW * 2 + 1);
+      }
+
+      if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record secondary command buffer!");
+      }
+    }));
+  }
+
+  // Rethrows the first error of the workers, once every job is done (the
+  // others may still be recording into the pools of the frame)
+  std::exception_ptr error;
+  for (auto &job : jobs) {
+    try {
+      job.get();
+    } catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  return secondary_command_buffers;
+}
+
+void Lvk::create_worker_command_pools() {
+  utils::trace::Scope scope("Lvk::create_worker_command_pools");
+
+  const QueueFamilyIndices &queue_family_indices =
+      this->capabilities.queue_family_indices;
+
+  // Pools are reset as a whole every frame (no individual reset), and the
+  // command buffers only live for one frame
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = queue_family_indices.graphics_family.value();
+
+  for (auto &frame : this->frames) {
+    frame.worker_command_pools.resize(this->recording_threads->size());
+    frame.secondary_command_buffers.resize(this->recording_threads->size());
+
+    for (size_t i = 0; i < frame.worker_command_pools.size(); ++i) {
+      if (vkCreateCommandPool(this->device, &pool_info, this->allocator,
+                              &frame.worker_command_pools[i]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create worker command pool!");
+      }
+
+      VkCommandBufferAllocateInfo alloc_info{};
+      alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      alloc_info.commandPool = frame.worker_command_pools[i];
+      alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      alloc_info.commandBufferCount = 1;
+
+      if (vkAllocateCommandBuffers(this->device, &alloc_info,
+                                   &frame.secondary_command_buffers[i]) !=
+          VK_SUCCESS) {
+        throw std::runtime_error(
+            "failed to allocate secondary command buffer!");
+      }
+    }
   }
 }
 
 void Lvk::create_sync_objects() {
-  // GPU synchronization
-  this->image_available_semaphore.resize(MAX_FRAMES_IN_FLIGHT);
-  this->render_finished_semaphore.resize(MAX_FRAMES_IN_FLIGHT);
-  this->in_flight_fence.resize(MAX_FRAMES_IN_FLIGHT);
+  utils::trace::Scope scope("Lvk::create_sync_objects");
 
+  // GPU synchronization
   VkSemaphoreCreateInfo semaphore_info{};
   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
@@ -926,164 +1380,1227 @@ void Lvk::create_sync_objects() {
   // VK_FENCE_CREATE_SIGNALED_BIT: The fence will be created in the signaled
   fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-    if (vkCreateSemaphore(device, &semaphore_info, nullptr,
-                          &this->image_available_semaphore[i]) != VK_SUCCESS ||
-        vkCreateSemaphore(device, &semaphore_info, nullptr,
-                          &this->render_finished_semaphore[i]) != VK_SUCCESS ||
-        vkCreateFence(device, &fence_info, nullptr,
-                      &this->in_flight_fence[i]) != VK_SUCCESS) {
+  // A single timeline replaces the fences: the GPU sets it to the number of
+  // each frame it finishes, so the CPU waits (or polls) for a frame number.
+  // Counter 0 = nothing submitted yet.
+  if (this->use_timeline_semaphore) {
+    this->timeline_semaphore_functions =
+        utils::sync::load_timeline_semaphore_functions(this->device);
+    this->frame_timeline =
+        utils::sync::create_timeline_semaphore(this->device, 0,
+                                               this->allocator);
+  }
+
+  for (auto &frame : this->frames) {
+    // Acquire and present only accept binary semaphores, so they are still
+    // needed with a window
+    if (!this->config.headless) {
+      if (vkCreateSemaphore(device, &semaphore_info, this->allocator,
+                            &frame.image_available_semaphore) != VK_SUCCESS ||
+          vkCreateSemaphore(device, &semaphore_info, this->allocator,
+                            &frame.render_finished_semaphore) != VK_SUCCESS) {
+        throw std::runtime_error(
+            "failed to create synchronization objects for a frame!");
+      }
+    }
+
+    if (!this->use_timeline_semaphore &&
+        vkCreateFence(device, &fence_info, this->allocator,
+                      &frame.in_flight_fence) != VK_SUCCESS) {
       throw std::runtime_error(
           "failed to create synchronization objects for a frame!");
     }
   }
 }
 
-VkShaderModule Lvk::create_shader_module(const std::vector<char> &code) {
-  VkShaderModuleCreateInfo create_info{};
-  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  create_info.codeSize = code.size();
-  create_info.pCode = reinterpret_cast<const uint32_t *>(code.data());
+void Lvk::create_query_pools() {
+  utils::trace::Scope scope("Lvk::create_query_pools");
+
+  const QueueFamilyIndices &indices = this->capabilities.queue_family_indices;
 
-  VkShaderModule shader_module;
-  if (vkCreateShaderModule(this->device, &create_info, nullptr,
-                           &shader_module) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create shader module!");
+  // Number of meaningful bits of the timestamps written on the queue family
+  // (0 means timestamps are not supported)
+  this->timestamp_valid_bits =
+      this->capabilities.queue_families[indices.graphics_family.value()]
+          .timestampValidBits;
+
+  if (this->timestamp_valid_bits == 0) {
+    utils::trace::out() << "Timestamps not supported, GPU timings disabled"
+                        << std::endl;
+    return;
   }
 
-  return shader_module;
-}
+  this->timestamp_period =
+      this->capabilities.properties.limits.timestampPeriod;
 
-void Lvk::run() {
+  this->gpu_pass_times.assign(
+      GPU_PASS_COUNT,
+      utils::timestamp::RollingWindow(this->config.gpu_timing_window));
 
-  while (!glfwWindowShouldClose(this->window)) {
-    glfwPollEvents();
-    this->draw_frame();
+  // Cached command buffers have their own pools (one per swap chain image)
+  if (this->config.cache_command_buffers) {
+    return;
   }
 
-  vkDeviceWaitIdle(this->device);
+  for (auto &frame : this->frames) {
+    frame.query_pool = this->create_timestamp_query_pool();
+  }
 }
 
-void Lvk::draw_frame() {
-  auto &command_buffer = this->command_buffers[current_frame];
-
-  auto &in_flight_fence = this->in_flight_fence[current_frame];
-  auto &image_available_semaphore = this->image_available_semaphore[current_frame];
-  auto &render_finished_semaphore = this->render_finished_semaphore[current_frame];
+VkQueryPool Lvk::create_timestamp_query_pool() {
+  if (this->timestamp_valid_bits == 0) {
+    return VK_NULL_HANDLE;
+  }
 
-  current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+  VkQueryPoolCreateInfo query_pool_info{};
+  query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  // A begin and an end timestamp for each pass
+  query_pool_info.queryCount = GPU_PASS_COUNT * 2;
 
-  // Wait for the command buffer to finish execution
-  vkWaitForFences(this->device, 1, &in_flight_fence, VK_TRUE, UINT64_MAX);
-  vkResetFences(this->device, 1, &in_flight_fence);
+  VkQueryPool query_pool;
+  if (vkCreateQueryPool(this->device, &query_pool_info, this->allocator,
+                        &query_pool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create query pool!");
+  }
 
-  uint32_t image_index;
-  // They will signaled when the image is acquired
-  vkAcquireNextImageKHR(this->device, this->swap_chain, UINT64_MAX,
-                        image_available_semaphore, VK_NULL_HANDLE,
-                        &image_index);
+  return query_pool;
+}
 
-  // Create the command buffer for that specific VkImage
-  vkResetCommandBuffer(command_buffer,
-                       /*VkCommandBufferResetFlagBits*/ 0);
-  this->record_command_buffer(command_buffer, image_index);
+void Lvk::collect_gpu_timings(VkQueryPool query_pool) {
+  // The frame fence is signaled so the results are already available, no need
+  // for `VK_QUERY_RESULT_WAIT_BIT` (which would stall)
+  uint64_t timestamps[GPU_PASS_COUNT * 2];
+  VkResult result = vkGetQueryPoolResults(
+      this->device, query_pool, 0, GPU_PASS_COUNT * 2,
+      sizeof(timestamps), timestamps, sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT);
 
-  /** Submit the command buffer */
-  // Queue submission and synchronization is configured in the `VkSubmitInfo`
-  // structure.
-  VkSubmitInfo submit_info{};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  if (result != VK_SUCCESS) {
+    return;
+  }
 
-  // The indices of `wait_semaphores` and `wait_stages` are correlated.
+  for (uint32_t pass = 0; pass < GPU_PASS_COUNT; ++pass) {
+    this->gpu_pass_times[pass].push(utils::timestamp::ticks_to_ms(
+        timestamps[pass * 2], timestamps[pass * 2 + 1], this->timestamp_period,
+        this->timestamp_valid_bits));
+  }
+}
 
-  // Semaphores to wait
-  std::vector<VkSemaphore> wait_semaphores = {image_available_semaphore};
-  // What stage of the pipeline to wait at
-  std::vector<VkPipelineStageFlags> wait_stages = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+void Lvk::create_cached_command_buffers() {
+  utils::trace::Scope scope("Lvk::create_cached_command_buffers");
 
-  submit_info.waitSemaphoreCount =
-      static_cast<uint32_t>(wait_semaphores.size());
-  submit_info.pWaitSemaphores = wait_semaphores.data();
-  submit_info.pWaitDstStageMask = wait_stages.data();
+  this->cached_command_buffers.resize(this->swap_chain_images.size());
 
-  // Specify which command buffers to actually submit for execution.
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &command_buffer;
+  std::vector<VkCommandBuffer> command_buffers(
+      this->cached_command_buffers.size());
 
-  // Specify which semaphores to signal once the command buffer(s) have finished
-  // execution.
-  std::vector<VkSemaphore> signal_semaphores = {
-      this->render_finished_semaphore};
-  submit_info.signalSemaphoreCount =
-      static_cast<uint32_t>(signal_semaphores.size());
-  submit_info.pSignalSemaphores = signal_semaphores.data();
+  VkCommandBufferAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.commandPool = this->command_pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandBufferCount =
+      static_cast<uint32_t>(command_buffers.size());
 
-  // Submit the command buffer to the graphics queue
-  if (vkQueueSubmit(this->graphics_queue, 1, &submit_info, in_flight_fence) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
+  if (vkAllocateCommandBuffers(this->device, &alloc_info,
+                               command_buffers.data()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate command buffers!");
   }
 
-  VkPresentInfoKHR present_info{};
-  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-  // wait the command buffer to finish execution
-  present_info.waitSemaphoreCount =
-      static_cast<uint32_t>(signal_semaphores.size());
-  present_info.pWaitSemaphores = signal_semaphores.data();
-
-  // Specify the swap chains to present images to and the index of the image for
-  // each swap chain.
-  std::vector<VkSwapchainKHR> swap_chains = {this->swap_chain};
-  present_info.swapchainCount = static_cast<uint32_t>(swap_chains.size());
-  present_info.pSwapchains = swap_chains.data();
-  present_info.pImageIndices = &image_index;
+  for (size_t i = 0; i < command_buffers.size(); ++i) {
+    auto &cached = this->cached_command_buffers[i];
 
-  // Submit the request to present the image to the swap chain.
-  vkQueuePresentKHR(this->present_queue, &present_info);
+    cached.command_buffer = command_buffers[i];
+    cached.query_pool = this->create_timestamp_query_pool();
+  }
 }
 
-void Lvk::clean_up() {
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-    vkDestroySemaphore(this->device, this->render_finished_semaphore[i],
-                       nullptr);
-    vkDestroySemaphore(this->device, this->image_available_semaphore[i],
-                       nullptr);
-    vkDestroyFence(this->device, this->in_flight_fence[i], nullptr);
+void Lvk::invalidate_command_buffers() {
+  for (auto &cached : this->cached_command_buffers) {
+    cached.dirty = true;
   }
+}
 
-  // Command buffers are freed when the command pool is destroyed
-  vkDestroyCommandPool(this->device, this->command_pool, nullptr);
-
-  for (auto framebuffer : this->swap_chain_framebuffers) {
-    vkDestroyFramebuffer(device, framebuffer, nullptr);
+void Lvk::set_draw_list(const std::vector<DrawCommand> &draw_list) {
+  // The camera, the transform of each draw and the identity of the instanced
+  // draws are written each frame (see `write_uniforms()`): throw here rather
+  // than in the middle of a frame
+  VkDeviceSize uniforms_size =
+      this->uniform_ring->get_allocation_size(sizeof(CameraUniforms)) +
+      (draw_list.size() + 1) *
+          this->uniform_ring->get_allocation_size(sizeof(ObjectUniforms));
+  if (uniforms_size > this->uniform_ring->get_region_size()) {
+    throw std::runtime_error("draw list too big for the uniform buffer!");
   }
 
-  vkDestroyPipeline(this->device, this->graphics_pipeline, nullptr);
-  vkDestroyPipelineLayout(this->device, this->pipeline_layout, nullptr);
-  vkDestroyRenderPass(this->device, this->render_pass, nullptr);
-
-  for (auto image_view : this->swap_chain_image_views) {
-    vkDestroyImageView(this->device, image_view, nullptr);
+  // Validated now rather than while recording
+  for (const auto &draw : draw_list) {
+    if (this->meshes.at(draw.mesh).vertex_buffer.buffer == VK_NULL_HANDLE) {
+      throw std::runtime_error("draw of a destroyed mesh!");
+    }
   }
 
-  vkDestroySwapchainKHR(this->device, this->swap_chain, nullptr);
+  this->draw_list = draw_list;
+  this->invalidate_command_buffers();
+}
 
-  vkDestroyDevice(this->device, nullptr);
+void Lvk::set_camera(const Matrix &view_projection) {
+  // Written each frame at the same offset
+  this->view_projection = view_projection;
+}
 
-  vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
+void Lvk::set_log_severity(utils::log::Severity severity) {
+  this->config.log_severity = severity;
 
-  if (enable_validation_layer) {
-    utils::messenger::destroy_debug_utils_messenger_ext(
-        this->instance, this->debug_messenger, nullptr);
+  // No logger without the validation layers
+  if (this->debug_logger) {
+    this->debug_logger->set_min_severity(severity);
   }
+}
 
-  vkDestroyInstance(instance, nullptr);
+void Lvk::create_descriptor_set_layout() {
+  utils::trace::Scope scope("Lvk::create_descriptor_set_layout");
+
+  // Dynamic: the offsets in the uniform ring change with the frame and the
+  // draw, the descriptor set doesn't
+  std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+  for (uint32_t i = 0; i < bindings.size(); ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[i].descriptorCount = 1;
+    // The culling reads the camera (`cull.comp`)
+    bindings[i].stageFlags =
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layout_info{};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+  layout_info.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(this->device, &layout_info, this->allocator,
+                                  &this->descriptor_set_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+}
+
+void Lvk::create_uniform_ring() {
+  utils::trace::Scope scope("Lvk::create_uniform_ring");
+
+  this->uniform_ring = std::make_unique<utils::uniform::UniformRing>(
+      *this->device_allocator, this->capabilities.properties.limits,
+      this->get_frame_region_count(), this->config.uniform_buffer_size);
+
+  /** Descriptor set */
+  VkDescriptorPoolSize pool_size{};
+  pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  pool_size.descriptorCount = 2;
+
+  VkDescriptorPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+
+  if (vkCreateDescriptorPool(this->device, &pool_info, this->allocator,
+                             &this->descriptor_pool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+
+  VkDescriptorSetAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = this->descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &this->descriptor_set_layout;
+
+  if (vkAllocateDescriptorSets(this->device, &alloc_info,
+                               &this->descriptor_set) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate descriptor set!");
+  }
+
+  // The ranges start at the dynamic offsets
+  VkDescriptorBufferInfo buffer_infos[2]{};
+  buffer_infos[0].buffer = this->uniform_ring->get_buffer();
+  buffer_infos[0].range = sizeof(CameraUniforms);
+  buffer_infos[1].buffer = this->uniform_ring->get_buffer();
+  buffer_infos[1].range = sizeof(ObjectUniforms);
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = this->descriptor_set;
+  write.dstBinding = 0;
+  write.descriptorCount = 2;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  write.pBufferInfo = buffer_infos;
+
+  vkUpdateDescriptorSets(this->device, 1, &write, 0, nullptr);
+
+  // The cached command buffers bind the previous set
+  this->invalidate_command_buffers();
+}
+
+void Lvk::write_uniforms(uint32_t region) {
+  this->uniform_ring->begin_region(region);
+
+  // Same order and sizes every frame, so the offsets only change with the
+  // region and the draw list (the cached command buffers replay them)
+  this->camera_offset =
+      this->uniform_ring->push(CameraUniforms{this->view_projection});
+
+  this->object_offsets.resize(this->draw_list.size());
+  for (size_t i = 0; i < this->draw_list.size(); ++i) {
+    this->object_offsets[i] =
+        this->uniform_ring->push(ObjectUniforms{this->draw_list[i].transform});
+  }
+
+  // The instances carry the transforms of the instanced draws
+  this->instanced_object_offset =
+      this->uniform_ring->push(ObjectUniforms{IDENTITY_MATRIX});
+}
+
+void Lvk::create_instance_buffer() {
+  this->instance_buffer = std::make_unique<utils::instance::InstanceBuffer>(
+      *this->device_allocator, this->get_frame_region_count());
+
+  // The cached command buffers bind the previous buffers
+  this->invalidate_command_buffers();
+}
+
+void Lvk::write_instances(uint32_t region) {
+  // The draws of the draw list read the instances `first_instance` to
+  // `first_instance + instance_count`: identity instances
+  size_t identity_count = 0;
+  for (const auto &draw : this->draw_list) {
+    identity_count = std::max<size_t>(
+        identity_count, draw.first_instance + draw.instance_count);
+  }
+
+  size_t instance_count = identity_count;
+  for (const auto &instances : this->pending_instances) {
+    instance_count += instances.size();
+  }
+
+  if (this->instance_buffer->begin_region(region,
+                                          instance_count * sizeof(Instance))) {
+    this->invalidate_command_buffers();
+  }
+
+  Instance *mapped =
+      static_cast<Instance *>(this->instance_buffer->get_mapped());
+  std::fill(mapped, mapped + identity_count, Instance{});
+
+  // The instances of each mesh are contiguous (one instanced draw), the
+  // draws only change with the number of instances of each mesh
+  bool changed = false;
+  size_t draw_count = 0;
+  uint32_t first_instance = static_cast<uint32_t>(identity_count);
+
+  for (size_t mesh = 0; mesh < this->pending_instances.size(); ++mesh) {
+    auto &instances = this->pending_instances[mesh];
+    if (instances.empty()) {
+      continue;
+    }
+
+    InstanceDraw draw;
+    draw.mesh = static_cast<uint32_t>(mesh);
+    draw.first_instance = first_instance;
+    draw.instance_count = static_cast<uint32_t>(instances.size());
+
+    if (draw_count == this->instance_draws.size()) {
+      this->instance_draws.push_back(draw);
+      changed = true;
+    } else if (this->instance_draws[draw_count] != draw) {
+      this->instance_draws[draw_count] = draw;
+      changed = true;
+    }
+    ++draw_count;
+
+    std::copy(instances.begin(), instances.end(), mapped + first_instance);
+    first_instance += draw.instance_count;
+    instances.clear();
+  }
+
+  if (draw_count != this->instance_draws.size()) {
+    this->instance_draws.resize(draw_count);
+    changed = true;
+  }
+
+  if (changed) {
+    this->invalidate_command_buffers();
+  }
+}
+
+uint32_t Lvk::get_frame_region_count() const {
+  // A region is rewritten once the command buffer that reads it is finished
+  return this->config.cache_command_buffers
+             ? static_cast<uint32_t>(this->cached_command_buffers.size())
+             : static_cast<uint32_t>(this->frames.size());
+}
+
+void Lvk::create_culling_pass() {
+  if (!this->use_gpu_culling) {
+    return;
+  }
+
+  utils::trace::Scope scope("Lvk::create_culling_pass");
+
+  this->culling_pass = std::make_unique<utils::culling::CullingPass>(
+      this->device, *this->device_allocator, this->pipeline_cache,
+      this->descriptor_set_layout, this->use_draw_indirect_count,
+      this->allocator);
+}
+
+bool Lvk::is_culling_scene_ready() const {
+  return this->culling_scene &&
+         this->culling_scene->upload_batch <= this->ready_upload_batch;
+}
+
+size_t Lvk::get_draw_count() const {
+  size_t gpu_draw_count =
+      this->is_culling_scene_ready() ? this->gpu_draw_meshes.size() : 0;
+  return this->draw_list.size() + this->instance_draws.size() +
+         gpu_draw_count;
+}
+
+bool Lvk::supports_gpu_objects() const {
+  return this->culling_pass != nullptr;
+}
+
+void Lvk::set_mesh_lods(uint32_t mesh, const std::vector<MeshLod> &lods) {
+  // Validated now rather than while uploading
+  this->meshes.at(mesh);
+  if (lods.size() > utils::culling::max_lods) {
+    throw std::runtime_error("too many mesh LODs!");
+  }
+
+  if (mesh >= this->mesh_lods.size()) {
+    this->mesh_lods.resize(mesh + 1);
+  }
+  this->mesh_lods[mesh] = lods;
+}
+
+void Lvk::set_gpu_objects(const std::vector<GpuObject> &objects) {
+  if (!this->culling_pass) {
+    throw std::runtime_error("GPU objects are not supported by the device!");
+  }
+
+  std::shared_ptr<utils::culling::CullingScene> scene;
+  std::vector<uint32_t> draw_meshes;
+
+  if (!objects.empty()) {
+    /** Meshes and their LODs */
+    std::vector<utils::culling::GpuMesh> gpu_meshes(this->meshes.size());
+    for (size_t mesh = 0; mesh < this->meshes.size(); ++mesh) {
+      utils::culling::GpuMesh &gpu_mesh = gpu_meshes[mesh];
+
+      std::vector<MeshLod> lods;
+      if (mesh < this->mesh_lods.size()) {
+        lods = this->mesh_lods[mesh];
+      }
+      if (lods.empty()) {
+        lods.push_back(MeshLod{});
+      }
+
+      gpu_mesh.lod_count = static_cast<uint32_t>(lods.size());
+      for (size_t lod = 0; lod < lods.size(); ++lod) {
+        gpu_mesh.lods[lod].first_index = lods[lod].first_index;
+        gpu_mesh.lods[lod].index_count = lods[lod].index_count == 0
+                                             ? this->meshes[mesh].index_count
+                                             : lods[lod].index_count;
+        gpu_mesh.lods[lod].vertex_offset = lods[lod].vertex_offset;
+        gpu_mesh.lods[lod].min_screen_radius = lods[lod].min_screen_radius;
+      }
+    }
+
+    /** Objects */
+    std::vector<uint32_t> object_counts(this->meshes.size(), 0);
+    std::vector<utils::culling::GpuObject> gpu_objects(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+      const GpuObject &object = objects[i];
+      if (this->meshes.at(object.mesh).vertex_buffer.buffer ==
+          VK_NULL_HANDLE) {
+        throw std::runtime_error("GPU object of a destroyed mesh!");
+      }
+      ++object_counts[object.mesh];
+
+      utils::culling::GpuObject &gpu_object = gpu_objects[i];
+      gpu_object.translation[0] = object.instance.translation[0];
+      gpu_object.translation[1] = object.instance.translation[1];
+      gpu_object.rotation = object.instance.rotation;
+      gpu_object.scale = object.instance.scale;
+      gpu_object.mesh = object.mesh;
+      gpu_object.radius = object.radius;
+    }
+
+    // One multi-draw per mesh, at most one draw per object
+    uint32_t max_draw_count =
+        this->capabilities.properties.limits.maxDrawIndirectCount;
+    for (uint32_t mesh = 0; mesh < object_counts.size(); ++mesh) {
+      if (object_counts[mesh] > max_draw_count) {
+        throw std::runtime_error("too many GPU objects of one mesh!");
+      }
+      if (object_counts[mesh] > 0) {
+        draw_meshes.push_back(mesh);
+      }
+    }
+
+    scene = this->culling_pass->create_scene(*this->staging_ring,
+                                             gpu_objects, gpu_meshes);
+  }
+
+  // The frames in flight may still cull the previous objects
+  if (this->culling_scene) {
+    utils::culling::CullingPass *culling_pass = this->culling_pass.get();
+    std::shared_ptr<utils::culling::CullingScene> retired =
+        std::move(this->culling_scene);
+    // A copy still running on the transfer queue is not a frame in flight
+    this->staging_ring->wait_for_batch(retired->upload_batch);
+    this->retire([culling_pass, retired]() {
+      culling_pass->destroy_scene(*retired);
+    });
+  }
+
+  this->culling_scene = std::move(scene);
+  this->gpu_draw_meshes = std::move(draw_meshes);
+  this->invalidate_command_buffers();
+}
+
+void Lvk::draw_instances(uint32_t mesh, const Instance *instances,
+                         size_t count) {
+  // Validated now rather than while recording
+  if (this->meshes.at(mesh).vertex_buffer.buffer == VK_NULL_HANDLE) {
+    throw std::runtime_error("instances of a destroyed mesh!");
+  }
+
+  if (mesh >= this->pending_instances.size()) {
+    this->pending_instances.resize(mesh + 1);
+  }
+  this->pending_instances[mesh].insert(this->pending_instances[mesh].end(),
+                                       instances, instances + count);
+}
+
+void Lvk::create_staging_ring() {
+  utils::trace::Scope scope("Lvk::create_staging_ring");
+
+  const QueueFamilyIndices &indices = this->capabilities.queue_family_indices;
+
+  // Without a transfer queue, the copies are submitted on the graphics queue
+  // before the frames that draw the meshes
+  uint32_t graphics_family = indices.graphics_family.value();
+  uint32_t transfer_family = graphics_family;
+  VkQueue transfer_queue = this->graphics_queue;
+  if (this->transfer_queue != VK_NULL_HANDLE) {
+    transfer_family = indices.transfer_family.value();
+    transfer_queue = this->transfer_queue;
+  }
+
+  this->staging_ring = std::make_unique<utils::staging::StagingRing>(
+      this->device, *this->device_allocator, transfer_family, transfer_queue,
+      graphics_family, this->graphics_queue, this->config.staging_buffer_size,
+      this->allocator);
+}
+
+uint32_t Lvk::create_mesh(const std::vector<Vertex> &vertices,
+                          const std::vector<uint32_t> &indices) {
+  utils::mesh::Mesh mesh = utils::mesh::create_mesh(
+      *this->device_allocator, *this->staging_ring, vertices.data(),
+      static_cast<uint32_t>(vertices.size()), sizeof(Vertex), indices);
+
+  this->meshes.push_back(mesh);
+
+  return static_cast<uint32_t>(this->meshes.size() - 1);
+}
+
+void Lvk::destroy_mesh(uint32_t mesh) {
+  // The frames in flight may still draw it
+  utils::memory::DeviceAllocator *device_allocator =
+      this->device_allocator.get();
+  utils::mesh::Mesh destroyed = this->meshes.at(mesh);
+  if (destroyed.vertex_buffer.buffer == VK_NULL_HANDLE) {
+    throw std::runtime_error("mesh already destroyed!");
+  }
+  for (const auto &draw : this->draw_list) {
+    if (draw.mesh == mesh) {
+      throw std::runtime_error("destroyed mesh still in the draw list!");
+    }
+  }
+
+  // A copy still running on the transfer queue is not a frame in flight
+  this->staging_ring->wait_for_batch(destroyed.upload_batch);
+  this->retire([device_allocator, destroyed]() {
+    utils::mesh::destroy_mesh(*device_allocator, destroyed);
+  });
+
+  this->meshes[mesh] = utils::mesh::Mesh{};
+
+  // Rejected from now on (see `draw_instances()`), the queued instances are
+  // dropped and the cached command buffers no longer draw it
+  if (mesh < this->pending_instances.size()) {
+    this->pending_instances[mesh].clear();
+  }
+  this->invalidate_command_buffers();
+}
+
+void Lvk::wait_for_frame(uint64_t frame_number) {
+  if (frame_number <= this->completed_frames) {
+    return;
+  }
+
+  // Frames signal their number, no need to know which context submitted it
+  if (this->use_timeline_semaphore) {
+    utils::sync::wait_timeline_semaphore(this->timeline_semaphore_functions,
+                                         this->device, this->frame_timeline,
+                                         frame_number);
+    this->completed_frames = std::max(this->completed_frames, frame_number);
+    return;
+  }
+
+  // The context that submitted it was maybe already reused by a later frame,
+  // waiting for the oldest frame after it is enough (they finish in order)
+  FrameContext *oldest = nullptr;
+  for (auto &frame : this->frames) {
+    if (frame.submitted_frame >= frame_number &&
+        (oldest == nullptr || frame.submitted_frame < oldest->submitted_frame)) {
+      oldest = &frame;
+    }
+  }
+
+  if (oldest == nullptr) {
+    return;
+  }
+
+  vkWaitForFences(this->device, 1, &oldest->in_flight_fence, VK_TRUE,
+                  UINT64_MAX);
+  this->completed_frames =
+      std::max(this->completed_frames, oldest->submitted_frame);
+}
+
+void Lvk::wait_for_queued_presents() {
+  if (!this->use_present_wait) {
+    return;
+  }
+
+  // The frame about to start is `submitted_frames + 1`, the frames before
+  // it down to `present_id + 1` may still be queued
+  uint64_t next_frame = this->submitted_frames + 1;
+  if (next_frame <= this->config.max_queued_presents + 1) {
+    return;
+  }
+
+  uint64_t present_id = next_frame - this->config.max_queued_presents - 1;
+  // Presented by an older swap chain, not known by the current one
+  if (present_id < this->first_present_id) {
+    return;
+  }
+
+  // Bounded so a present that is never displayed (e.g. minimized window) can't
+  // block the loop, the pacing is skipped for this frame. `VK_TIMEOUT`,
+  // `VK_SUBOPTIMAL_KHR` and `VK_ERROR_OUT_OF_DATE_KHR` are handled by the
+  // acquire/present.
+  const uint64_t timeout_ns = 100'000'000;
+  VkResult result = this->wait_for_present(this->device, this->swap_chain,
+                                           present_id, timeout_ns);
+
+  if (result == VK_ERROR_DEVICE_LOST) {
+    throw std::runtime_error("failed to wait for present!");
+  }
+}
+
+bool Lvk::is_frame_finished(uint64_t frame_number) {
+  if (frame_number <= this->completed_frames) {
+    return true;
+  }
+
+  if (this->use_timeline_semaphore) {
+    this->completed_frames = utils::sync::get_timeline_semaphore_value(
+        this->timeline_semaphore_functions, this->device,
+        this->frame_timeline);
+  } else {
+    // Without a timeline, the signaled fences tell which frames are done
+    for (const auto &frame : this->frames) {
+      if (frame.submitted_frame > this->completed_frames &&
+          vkGetFenceStatus(this->device, frame.in_flight_fence) ==
+              VK_SUCCESS) {
+        this->completed_frames = frame.submitted_frame;
+      }
+    }
+  }
+
+  return frame_number <= this->completed_frames;
+}
+
+void Lvk::retire(std::function<void()> destroy, uint64_t delay_frames) {
+  // Kept sorted by frame, the delayed ones don't hold back the others
+  uint64_t frame_number = this->submitted_frames + delay_frames;
+  auto position = std::upper_bound(
+      this->retired_resources.begin(), this->retired_resources.end(),
+      frame_number, [](uint64_t frame, const auto &retired) {
+        return frame < retired.first;
+      });
+  this->retired_resources.emplace(position, frame_number, std::move(destroy));
+}
+
+void Lvk::destroy_retired_resources() {
+  // Sorted by frame, so the oldest ones are at the front
+  while (!this->retired_resources.empty() &&
+         this->is_frame_finished(this->retired_resources.front().first)) {
+    this->retired_resources.front().second();
+    this->retired_resources.pop_front();
+  }
+}
+
+std::vector<GpuPassTiming> Lvk::get_gpu_timings() const {
+  std::vector<GpuPassTiming> timings;
+
+  for (size_t pass = 0; pass < this->gpu_pass_times.size(); ++pass) {
+    const auto &times = this->gpu_pass_times[pass];
+
+    GpuPassTiming timing;
+    timing.name = gpu_pass_names[pass];
+    timing.last_ms = times.last();
+    timing.average_ms = times.average();
+    timing.max_ms = times.max();
+
+    timings.push_back(timing);
+  }
+
+  return timings;
+}
+
+void Lvk::create_shader_watcher() {
+  utils::trace::Scope scope("Lvk::create_shader_watcher");
+
+  this->shader_watcher = std::make_unique<utils::watch::DirectoryWatcher>(
+      this->config.shader_source_dir);
+  this->shader_reload_thread =
+      std::make_unique<utils::thread_pool::ThreadPool>(1);
+
+  utils::trace::out() << "Hot reload: watching "
+                      << this->config.shader_source_dir << std::endl;
+}
+
+void Lvk::reload_shaders() {
+  const auto &description = this->graphics_pipeline_description;
+
+  // Only the shaders of the pipeline (other files are ignored)
+  std::vector<std::string> shaders;
+  for (const auto &name : this->changed_shaders) {
+    if (name == description.vertex_shader ||
+        name == description.fragment_shader) {
+      shaders.push_back(name);
+    }
+  }
+  this->changed_shaders.clear();
+
+  if (shaders.empty()) {
+    return;
+  }
+
+  // Compiled off the render thread, the current pipeline is drawn meanwhile
+  VkDevice device = this->device;
+  VkPipelineCache pipeline_cache = this->pipeline_cache;
+  const VkAllocationCallbacks *allocator = this->allocator;
+  std::string source_dir = this->config.shader_source_dir;
+  std::string output_dir = this->config.shader_dir;
+
+  this->pending_graphics_pipeline = utils::pipeline::PipelineHandle(
+      this->shader_reload_thread
+          ->submit([device, pipeline_cache, allocator, description, shaders,
+                    source_dir, output_dir]() {
+            for (const auto &name : shaders) {
+              utils::shader::compile_glsl(source_dir + "/" + name,
+                                          output_dir + "/" + name + ".spv");
+            }
+
+            return utils::pipeline::create_graphics_pipeline(
+                device, pipeline_cache, description, allocator);
+          })
+          .share());
+}
+
+void Lvk::update_pipelines() {
+  if (this->shader_watcher) {
+    for (auto &name : this->shader_watcher->poll()) {
+      this->changed_shaders.insert(name);
+    }
+  }
+
+  // One compilation at a time, the changes wait for the current one
+  if (this->pending_graphics_pipeline.valid() &&
+      !this->pending_graphics_pipeline.is_ready()) {
+    return;
+  }
+
+  if (!this->pending_graphics_pipeline.valid()) {
+    if (!this->changed_shaders.empty()) {
+      this->reload_shaders();
+    }
+    return;
+  }
+
+  VkPipeline pipeline;
+  try {
+    pipeline = this->pending_graphics_pipeline.get();
+    this->pending_graphics_pipeline = utils::pipeline::PipelineHandle();
+  } catch (const std::exception &e) {
+    this->pending_graphics_pipeline = utils::pipeline::PipelineHandle();
+
+    // A shader being edited must not stop the render loop
+    if (!this->config.hot_reload) {
+      throw;
+    }
+    std::cerr << "Hot reload: " << e.what() << std::endl;
+    return;
+  }
+
+  // The placeholder may still be used by the frames in flight
+  VkDevice device = this->device;
+  VkPipeline placeholder = this->graphics_pipeline;
+  const VkAllocationCallbacks *allocator = this->allocator;
+  this->retire([device, placeholder, allocator]() {
+    vkDestroyPipeline(device, placeholder, allocator);
+  });
+
+  this->graphics_pipeline = pipeline;
+  // The cached command buffers bind the placeholder
+  this->invalidate_command_buffers();
+}
+
+void Lvk::run() {
+  uint32_t frames = 0;
+
+  while (this->config.max_frames == 0 || frames < this->config.max_frames) {
+    if (this->should_close()) {
+      break;
+    }
+
+    this->poll_events();
+    this->draw_frame();
+    ++frames;
+  }
+
+  vkDeviceWaitIdle(this->device);
+}
+
+void Lvk::poll_events() {
+  if (!this->config.headless) {
+    glfwPollEvents();
+  }
+}
+
+bool Lvk::should_close() {
+  return !this->config.headless && glfwWindowShouldClose(this->window);
+}
+
+const FrameTimings &Lvk::get_frame_timings() const {
+  return this->frame_timings;
+}
+
+void Lvk::draw_frame() {
+  auto frame_start = std::chrono::steady_clock::now();
+  this->frame_timings = FrameTimings{};
+  if (this->host_allocator) {
+    this->host_allocator->begin_frame();
+  }
+
+  uint32_t frame_index = this->current_frame;
+  FrameContext &frame = this->frames[frame_index];
+
+  auto &command_buffer = frame.command_buffer;
+  auto &image_available_semaphore = frame.image_available_semaphore;
+  auto &render_finished_semaphore = frame.render_finished_semaphore;
+
+  // Headless renders the frame `i` into the offscreen image `i`
+  uint32_t image_index = this->current_frame;
+
+  this->current_frame = (this->current_frame + 1) % this->frames.size();
+
+  // Start the frame just in time: at most `max_queued_presents` frames are
+  // waiting to be displayed
+  auto step_start = std::chrono::steady_clock::now();
+  this->wait_for_queued_presents();
+  this->frame_timings.present_wait_ms = elapsed_ms(step_start);
+
+  // Wait for the command buffer to finish execution (submissions finish in
+  // order, so every frame up to this one is done)
+  step_start = std::chrono::steady_clock::now();
+  this->wait_for_frame(frame.submitted_frame);
+  this->frame_timings.wait_ms = elapsed_ms(step_start);
+
+  this->destroy_retired_resources();
+  this->update_pipelines();
+
+  // Start the uploads recorded since the last frame, the meshes whose copies
+  // are done are drawn from this frame
+  this->staging_ring->flush();
+  this->staging_ring->hand_off();
+  if (this->staging_ring->get_ready_batch() != this->ready_upload_batch) {
+    this->ready_upload_batch = this->staging_ring->get_ready_batch();
+    // The cached command buffers skip them
+    this->invalidate_command_buffers();
+  }
+
+  // The previous submission of this frame is done, its timestamps are ready
+  if (frame.query_pool_submitted) {
+    this->collect_gpu_timings(frame.query_pool);
+  }
+
+  // They will signaled when the image is acquired
+  if (!this->config.headless) {
+    step_start = std::chrono::steady_clock::now();
+
+    // The swap chain no longer matches the surface (e.g. resized): recreate
+    // it and acquire from the new one
+    VkResult result;
+    while ((result = vkAcquireNextImageKHR(
+                this->device, this->swap_chain, UINT64_MAX,
+                image_available_semaphore, VK_NULL_HANDLE, &image_index)) ==
+           VK_ERROR_OUT_OF_DATE_KHR) {
+      this->recreate_swap_chain();
+    }
+
+    // `VK_SUBOPTIMAL_KHR` can still be presented, it is recreated after the
+    // present
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      throw std::runtime_error("failed to acquire swap chain image!");
+    }
+
+    this->frame_timings.acquire_ms = elapsed_ms(step_start);
+  }
+
+  // Create the command buffer for that specific VkImage
+  step_start = std::chrono::steady_clock::now();
+
+  // Command buffer actually submitted
+  VkCommandBuffer submit_command_buffer = command_buffer;
+
+  if (this->config.cache_command_buffers) {
+    CachedCommandBuffer &cached = this->cached_command_buffers[image_index];
+
+    // A command buffer can't be submitted (nor recorded) again while its
+    // previous submission is pending. Usually already done, since the image
+    // was presented since then.
+    this->wait_for_frame(cached.submitted_frame);
+    this->write_uniforms(image_index);
+    this->write_instances(image_index);
+
+    if (cached.query_pool_submitted) {
+      this->collect_gpu_timings(cached.query_pool);
+    }
+
+    // Only record again if something changed
+    if (cached.dirty) {
+      vkResetCommandBuffer(cached.command_buffer, 0);
+      this->record_command_buffer(cached.command_buffer, image_index,
+                                  cached.query_pool);
+      cached.dirty = false;
+    }
+
+    submit_command_buffer = cached.command_buffer;
+  } else {
+    // The previous submission of the frame context is finished
+    this->write_uniforms(frame_index);
+    this->write_instances(frame_index);
+
+    // The draws are recorded in parallel into secondary command buffers
+    std::vector<VkCommandBuffer> secondary_command_buffers;
+    if (this->recording_threads) {
+      secondary_command_buffers = this->record_secondary_command_buffers(
+          frame, image_index, frame.query_pool);
+    }
+
+    vkResetCommandBuffer(command_buffer,
+                         /*VkCommandBufferResetFlagBits*/ 0);
+    this->record_command_buffer(command_buffer, image_index, frame.query_pool,
+                                secondary_command_buffers);
+  }
+
+  this->frame_timings.record_ms = elapsed_ms(step_start);
+
+  /** Submit the command buffer */
+  // Queue submission and synchronization is configured in the `VkSubmitInfo`
+  // structure.
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+  // The indices of `wait_semaphores` and `wait_stages` are correlated.
+
+  // Semaphores to wait (headless has no image to acquire, so nothing to wait)
+  std::vector<VkSemaphore> wait_semaphores;
+  // What stage of the pipeline to wait at
+  std::vector<VkPipelineStageFlags> wait_stages;
+
+  if (!this->config.headless) {
+    wait_semaphores.push_back(image_available_semaphore);
+    wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  }
+
+  submit_info.waitSemaphoreCount =
+      static_cast<uint32_t>(wait_semaphores.size());
+  submit_info.pWaitSemaphores = wait_semaphores.data();
+  submit_info.pWaitDstStageMask = wait_stages.data();
+
+  // Specify which command buffers to actually submit for execution.
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &submit_command_buffer;
+
+  // Specify which semaphores to signal once the command buffer(s) have finished
+  // execution (nothing waits on them when headless).
+  std::vector<VkSemaphore> signal_semaphores;
+
+  if (!this->config.headless) {
+    signal_semaphores.push_back(render_finished_semaphore);
+  }
+  // Number of this frame, signaled on the timeline when it is finished
+  uint64_t frame_number = this->submitted_frames + 1;
+
+  // The values of the binary semaphores are ignored, but there must be one per
+  // semaphore
+  std::vector<uint64_t> wait_values(wait_semaphores.size(), 0);
+  std::vector<uint64_t> signal_values(signal_semaphores.size(), 0);
+
+  VkTimelineSemaphoreSubmitInfoKHR timeline_info{};
+  timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+
+  if (this->use_timeline_semaphore) {
+    signal_semaphores.push_back(this->frame_timeline);
+    signal_values.push_back(frame_number);
+
+    timeline_info.waitSemaphoreValueCount =
+        static_cast<uint32_t>(wait_values.size());
+    timeline_info.pWaitSemaphoreValues = wait_values.data();
+    timeline_info.signalSemaphoreValueCount =
+        static_cast<uint32_t>(signal_values.size());
+    timeline_info.pSignalSemaphoreValues = signal_values.data();
+
+    submit_info.pNext = &timeline_info;
+  }
+
+  submit_info.signalSemaphoreCount =
+      static_cast<uint32_t>(signal_semaphores.size());
+  submit_info.pSignalSemaphores = signal_semaphores.data();
+
+  // Only reset once the frame will really be submitted (an early exit, e.g. a
+  // throw while writing or recording, would leave it unsignaled and the next
+  // wait would never return)
+  if (!this->use_timeline_semaphore) {
+    vkResetFences(this->device, 1, &frame.in_flight_fence);
+  }
+
+  // Submit the command buffer to the graphics queue (after the uploads, or
+  // their acquire, of the meshes it draws)
+  step_start = std::chrono::steady_clock::now();
+  if (vkQueueSubmit(this->graphics_queue, 1, &submit_info,
+                    frame.in_flight_fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit draw command buffer!");
+  }
+  this->frame_timings.submit_ms = elapsed_ms(step_start);
+
+  frame.submitted_frame = this->submitted_frames = frame_number;
+
+  if (this->config.cache_command_buffers) {
+    CachedCommandBuffer &cached = this->cached_command_buffers[image_index];
+
+    cached.submitted_frame = frame.submitted_frame;
+    cached.query_pool_submitted = cached.query_pool != VK_NULL_HANDLE;
+  } else {
+    frame.query_pool_submitted = frame.query_pool != VK_NULL_HANDLE;
+  }
+
+  // The offscreen image is done once the frame is finished
+  if (this->config.headless) {
+    this->end_frame_timings(frame_start);
+    return;
+  }
+
+  VkPresentInfoKHR present_info{};
+  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  // wait the command buffer to finish execution
+  present_info.waitSemaphoreCount = 1;
+  present_info.pWaitSemaphores = &render_finished_semaphore;
+
+  // Specify the swap chains to present images to and the index of the image for
+  // each swap chain.
+  std::vector<VkSwapchainKHR> swap_chains = {this->swap_chain};
+  present_info.swapchainCount = static_cast<uint32_t>(swap_chains.size());
+  present_info.pSwapchains = swap_chains.data();
+  present_info.pImageIndices = &image_index;
+
+  // The present id is the frame number, waited by `wait_for_queued_presents()`
+  VkPresentIdKHR present_id{};
+  present_id.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+  present_id.swapchainCount = 1;
+  present_id.pPresentIds = &frame.submitted_frame;
+
+  if (this->use_present_wait) {
+    present_info.pNext = &present_id;
+  }
+
+  // Submit the request to present the image to the swap chain.
+  step_start = std::chrono::steady_clock::now();
+  VkResult result = vkQueuePresentKHR(this->present_queue, &present_info);
+  this->frame_timings.present_ms = elapsed_ms(step_start);
+
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+      this->framebuffer_resized) {
+    this->framebuffer_resized = false;
+    this->recreate_swap_chain();
+  } else if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to present swap chain image!");
+  }
+
+  this->end_frame_timings(frame_start);
+}
+
+void Lvk::end_frame_timings(
+    std::chrono::steady_clock::time_point frame_start) {
+  this->frame_timings.cpu_frame_ms = elapsed_ms(frame_start);
+
+  // Driver allocations of the frame (should stay at 0 in the steady state)
+  if (this->host_allocator) {
+    this->frame_timings.host_allocations =
+        this->host_allocator->get_frame_allocations();
+    this->frame_timings.host_allocated_bytes =
+        this->host_allocator->get_frame_bytes();
+  }
+}
+
+void Lvk::clean_up() {
+  // `draw_frame()` can be called without `run()`, so the GPU may still be using
+  // the resources
+  vkDeviceWaitIdle(this->device);
+
+  // Including the delayed ones, nothing is queued anymore
+  this->completed_frames = this->submitted_frames;
+  for (auto &retired : this->retired_resources) {
+    retired.second();
+  }
+  this->retired_resources.clear();
+
+  for (const auto &mesh : this->meshes) {
+    if (mesh.vertex_buffer.buffer != VK_NULL_HANDLE) {
+      utils::mesh::destroy_mesh(*this->device_allocator, mesh);
+    }
+  }
+  if (this->culling_scene) {
+    this->culling_pass->destroy_scene(*this->culling_scene);
+    this->culling_scene.reset();
+  }
+  this->culling_pass.reset();
+  this->staging_ring.reset();
+
+  // Also frees the descriptor set
+  vkDestroyDescriptorPool(this->device, this->descriptor_pool, this->allocator);
+  this->uniform_ring.reset();
+  this->instance_buffer.reset();
+
+  for (auto &frame : this->frames) {
+    vkDestroySemaphore(this->device, frame.render_finished_semaphore,
+                       this->allocator);
+    vkDestroySemaphore(this->device, frame.image_available_semaphore,
+                       this->allocator);
+    vkDestroyFence(this->device, frame.in_flight_fence, this->allocator);
+
+    if (frame.query_pool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(this->device, frame.query_pool, this->allocator);
+    }
+
+    // Also frees the secondary command buffers
+    for (auto worker_command_pool : frame.worker_command_pools) {
+      vkDestroyCommandPool(this->device, worker_command_pool, this->allocator);
+    }
+  }
+
+  for (auto &cached : this->cached_command_buffers) {
+    if (cached.query_pool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(this->device, cached.query_pool, this->allocator);
+    }
+  }
+
+  if (this->use_timeline_semaphore) {
+    vkDestroySemaphore(this->device, this->frame_timeline, this->allocator);
+  }
+
+  // Command buffers are freed when the command pool is destroyed
+  vkDestroyCommandPool(this->device, this->command_pool, this->allocator);
+
+  for (auto framebuffer : this->swap_chain_framebuffers) {
+    vkDestroyFramebuffer(device, framebuffer, this->allocator);
+  }
+
+  // Waits for the compilations still running on the workers
+  this->pipeline_builder.reset();
+  this->shader_reload_thread.reset();
+  if (this->pending_graphics_pipeline.valid()) {
+    try {
+      vkDestroyPipeline(this->device, this->pending_graphics_pipeline.get(),
+                        this->allocator);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+    }
+  }
+  vkDestroyPipeline(this->device, this->graphics_pipeline, this->allocator);
+
+  // Saving is best effort (called from the destructor), the next run
+  // compiles again
+  if (this->pipeline_cache != VK_NULL_HANDLE) {
+    try {
+      utils::pipeline_cache::save_pipeline_cache(
+          this->device, this->capabilities.properties, this->pipeline_cache,
+          this->pipeline_cache_path);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+    }
+
+    vkDestroyPipelineCache(this->device, this->pipeline_cache, this->allocator);
+  }
+  vkDestroyPipelineLayout(this->device, this->pipeline_layout, this->allocator);
+  vkDestroyDescriptorSetLayout(this->device, this->descriptor_set_layout,
+                               this->allocator);
+  vkDestroyRenderPass(this->device, this->render_pass, this->allocator);
+
+  for (auto image_view : this->swap_chain_image_views) {
+    vkDestroyImageView(this->device, image_view, this->allocator);
+  }
+
+  if (this->config.headless) {
+    for (const auto &image : this->offscreen_images) {
+      this->device_allocator->destroy_image(image);
+    }
+  } else {
+    vkDestroySwapchainKHR(this->device, this->swap_chain, this->allocator);
+  }
+
+  this->device_allocator->print_statistics(utils::trace::out());
+  this->device_allocator.reset();
+
+  vkDestroyDevice(this->device, this->allocator);
+
+  if (!this->config.headless) {
+    vkDestroySurfaceKHR(this->instance, this->surface, this->allocator);
+  }
+
+  if (enable_validation_layer) {
+    utils::messenger::destroy_debug_utils_messenger_ext(
+        this->instance, this->debug_messenger, this->allocator);
+  }
+
+  // Writes the waiting messages and the counters (no more callbacks)
+  this->debug_logger.reset();
+
+  vkDestroyInstance(instance, this->allocator);
+
+  if (this->host_allocator) {
+    this->host_allocator->print_statistics(utils::trace::out());
+  }
 
   // Finalize the windows
-  glfwDestroyWindow(this->window);
+  if (!this->config.headless) {
+    glfwDestroyWindow(this->window);
 
-  glfwTerminate();
+    glfwTerminate();
+  }
 }
 
 Lvk::~Lvk() { this->clean_up(); }
@@ -2,14 +2,275 @@
 #define _VLK_HPP
 
 // Load the Vulkan header
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "../utils/allocator/allocator.hpp"
+#include "../utils/capability/capability.hpp"
+#include "../utils/culling/culling.hpp"
+#include "../utils/device/device.hpp"
+#include "../utils/instance/instance.hpp"
+#include "../utils/log/log.hpp"
+#include "../utils/memory/memory.hpp"
+#include "../utils/mesh/mesh.hpp"
+#include "../utils/pipeline/pipeline.hpp"
+#include "../utils/pipeline_cache/pipeline_cache.hpp"
+#include "../utils/staging/staging.hpp"
+#include "../utils/swapchain/swapchain.hpp"
+#include "../utils/sync/sync.hpp"
+#include "../utils/thread_pool/thread_pool.hpp"
+#include "../utils/timestamp/timestamp.hpp"
+#include "../utils/trace/trace.hpp"
+#include "../utils/uniform/uniform.hpp"
+#include "../utils/watch/watch.hpp"
+
 namespace lvk {
+/** Options used to create the `Lvk` instance */
+struct Config {
+  // Render into offscreen `VkImage`s instead of a GLFW window, so no display
+  // (or window system) is needed
+  bool headless = false;
+  // Size of the window (or of the offscreen images when `headless`)
+  uint32_t width = 800;
+  uint32_t height = 600;
+  // Number of frames drawn by `run()` before returning (0 = no limit)
+  uint32_t max_frames = 0;
+  // Number of frames in the rolling window of `get_gpu_timings()`
+  uint32_t gpu_timing_window = 120;
+  // Number of frames the CPU can record while the GPU is still rendering the
+  // previous ones (1 = lowest latency, 3 = highest throughput)
+  uint32_t frames_in_flight = 2;
+  // Record one command buffer per swap chain image and submit it again while
+  // nothing changed (pipeline, extent or draw list), instead of recording
+  // every frame. Best for mostly static scenes.
+  bool cache_command_buffers = false;
+  // Number of threads recording the draw list into secondary command buffers
+  // (0 = record on the calling thread). Used when recording every frame, the
+  // cached command buffers are recorded on the calling thread.
+  uint32_t recording_threads = 0;
+  // Pace the frames with one timeline semaphore (`VK_KHR_timeline_semaphore`)
+  // instead of a fence per frame in flight, when the device supports it
+  bool timeline_semaphore = true;
+  // Present mode and number of swap chain images (ignored when headless)
+  utils::swapchain::PresentPolicy present_policy =
+      utils::swapchain::PresentPolicy::LOWEST_LATENCY;
+  // Frames that can wait to be displayed when a new one starts, enforced with
+  // `VK_KHR_present_wait` when supported (0 = not paced, never with
+  // `MAX_THROUGHPUT`)
+  uint32_t max_queued_presents = 1;
+  // Directory of the pipeline cache kept between runs ("" = no cache, the
+  // pipelines are compiled from scratch every run)
+  std::string pipeline_cache_dir =
+      utils::pipeline_cache::get_default_directory();
+  // File of the enumerated extensions, layers, features and queue families,
+  // read instead of enumerating them again ("" = enumerate every run)
+  std::string capability_cache_path = "build/capabilities.bin";
+  // Threads compiling the pipelines with the shared cache. An unoptimized
+  // placeholder is drawn until they are done (0 = compile the optimized
+  // pipelines during the initialization)
+  uint32_t pipeline_compile_threads = 2;
+  // Directory of the SPIR-V files (`<name>.spv`) loaded instead of the
+  // shaders embedded in the executable ("" = embedded)
+  std::string shader_dir;
+  // Development mode: the GLSL files of `shader_source_dir` are watched and
+  // compiled (into `shader_dir`, `build/shaders` if empty) when they change,
+  // the pipelines using them are swapped once compiled
+  bool hot_reload = false;
+  std::string shader_source_dir = "shaders";
+  // Minimum severity of the validation layer messages written to stderr
+  // (each message ID is written once, the repeats are counted)
+  utils::log::Severity log_severity = utils::log::Severity::WARNING;
+  // Pooled host allocator passed to the driver (false = the driver allocates
+  // with its own `malloc`)
+  bool host_allocator = true;
+  // Device memory blocks that the buffers and images are suballocated from
+  // (smaller on small heaps, bigger resources get their own allocation)
+  VkDeviceSize device_memory_block_size = 64 * 1024 * 1024;
+  // Ring the meshes are uploaded through (bigger uploads stream through it)
+  VkDeviceSize staging_buffer_size = 8 * 1024 * 1024;
+  // Upload on a queue of a dedicated transfer family when there is one (the
+  // copies run alongside the rendering, false = on the graphics queue)
+  bool transfer_queue = true;
+  // Uniforms written each frame (camera, transform of each draw), per frame
+  // in flight
+  VkDeviceSize uniform_buffer_size = 1024 * 1024;
+  // Print the initialization steps (and their details) on stdout
+  bool verbose = false;
+  // Chrome trace (JSON) of the initialization phases written once `Lvk` is
+  // constructed ("" = not traced)
+  std::string trace_path;
+};
+
+/** Vertex of the meshes (inputs of `shader.vert`) */
+struct Vertex {
+  float position[2];
+  float color[3];
+};
+
+/** Instance attributes of `shader.vert` (binding 1), applied to the vertices
+ * before the model matrix */
+struct Instance {
+  float translation[2] = {0.0f, 0.0f};
+  // Radians, counterclockwise
+  float rotation = 0.0f;
+  float scale = 1.0f;
+};
+
+/** One instanced draw of a mesh (built from `Lvk::draw_instances()`) */
+struct InstanceDraw {
+  uint32_t mesh = 0;
+  // In the instance buffer of the frame
+  uint32_t first_instance = 0;
+  uint32_t instance_count = 0;
+
+  bool operator==(const InstanceDraw &) const = default;
+};
+
+/** Level of detail of a mesh: range of its indices (`Lvk::set_mesh_lods()`)
+ */
+struct MeshLod {
+  uint32_t first_index = 0;
+  // 0 = every index of the mesh
+  uint32_t index_count = 0;
+  int32_t vertex_offset = 0;
+  // Drawn while the radius of the object on screen (NDC, 1 = half of the
+  // screen) is at least this, otherwise the next LOD is tried
+  float min_screen_radius = 0.0f;
+};
+
+/** Object culled and drawn by the GPU (`Lvk::set_gpu_objects()`) */
+struct GpuObject {
+  uint32_t mesh = 0;
+  Instance instance;
+  // Bounding circle around the origin of the mesh (before the scale)
+  float radius = 1.0f;
+};
+
+// The culling writes the instances read by `shader.vert`
+static_assert(sizeof(Instance) == sizeof(utils::culling::GpuInstance));
+
+/** Column-major 4x4 matrix (`mat4` of GLSL) */
+using Matrix = std::array<float, 16>;
+const Matrix IDENTITY_MATRIX = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+                                0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                0.0f, 0.0f, 0.0f, 1.0f};
+
+/** `Camera` uniform block of `shader.vert` (set 0, binding 0) */
+struct CameraUniforms {
+  Matrix view_projection;
+};
+
+/** `Object` uniform block of `shader.vert` (set 0, binding 1), per draw */
+struct ObjectUniforms {
+  Matrix model;
+};
+
+/** Parameters of a `vkCmdDrawIndexed` */
+struct DrawCommand {
+  // Returned by `Lvk::create_mesh()`
+  uint32_t mesh = 0;
+  // 0 = every index of the mesh
+  uint32_t index_count = 0;
+  uint32_t instance_count = 1;
+  uint32_t first_index = 0;
+  int32_t vertex_offset = 0;
+  uint32_t first_instance = 0;
+  // Model matrix of the draw (`ObjectUniforms`)
+  Matrix transform = IDENTITY_MATRIX;
+};
+
+/** CPU time (milliseconds) spent in each step of the last `draw_frame()` */
+struct FrameTimings {
+  // Whole `draw_frame()`
+  double cpu_frame_ms = 0.0;
+  // Pacing on the presents (0 without `VK_KHR_present_wait`)
+  double present_wait_ms = 0.0;
+  // Waiting for the previous submission of the frame context (GPU still busy
+  // with it)
+  double wait_ms = 0.0;
+  // `vkAcquireNextImageKHR` (0 when headless)
+  double acquire_ms = 0.0;
+  // Recording the command buffer
+  double record_ms = 0.0;
+  // `vkQueueSubmit`
+  double submit_ms = 0.0;
+  // `vkQueuePresentKHR` (0 when headless)
+  double present_ms = 0.0;
+  // Host allocations made by the driver during the frame (0 without the host
+  // allocator)
+  uint64_t host_allocations = 0;
+  uint64_t host_allocated_bytes = 0;
+};
+
+/** GPU time (milliseconds) of a recorded pass over the last frames */
+struct GpuPassTiming {
+  std::string name;
+  double last_ms = 0.0;
+  double average_ms = 0.0;
+  double max_ms = 0.0;
+};
+
+/** Resources owned by one frame in flight */
+struct FrameContext {
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+
+  // Signaled when the swap chain image is acquired (waited by the submit),
+  // `VK_NULL_HANDLE` when headless
+  VkSemaphore image_available_semaphore = VK_NULL_HANDLE;
+  // Signaled when the command buffer finished (waited by the present),
+  // `VK_NULL_HANDLE` when headless
+  VkSemaphore render_finished_semaphore = VK_NULL_HANDLE;
+  // Signaled when the GPU finished the frame (waited by the CPU before reusing
+  // any resource of this context), `VK_NULL_HANDLE` with the timeline
+  // semaphore
+  VkFence in_flight_fence = VK_NULL_HANDLE;
+
+  // Timestamps of the frame (`VK_NULL_HANDLE` if not supported)
+  VkQueryPool query_pool = VK_NULL_HANDLE;
+  // If the pool has results to read (it was submitted at least once)
+  bool query_pool_submitted = false;
+
+  // One pool (and secondary command buffer) per slice of the draw list, as
+  // many as recording threads: a pool is only used by the job recording its
+  // slice
+  std::vector<VkCommandPool> worker_command_pools;
+  std::vector<VkCommandBuffer> secondary_command_buffers;
+
+  // Number (`Lvk::submitted_frames`) of the last frame submitted with this
+  // context, finished once `in_flight_fence` is signaled (or the timeline
+  // reaches it)
+  uint64_t submitted_frame = 0;
+};
+
+/** Command buffer recorded for one swap chain image (cached mode) */
+struct CachedCommandBuffer {
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+
+  // Timestamps written by the command buffer (`VK_NULL_HANDLE` if not
+  // supported)
+  VkQueryPool query_pool = VK_NULL_HANDLE;
+  bool query_pool_submitted = false;
+
+  // Must be recorded again before its next submit
+  bool dirty = true;
+
+  // Number of the last frame that submitted it
+  uint64_t submitted_frame = 0;
+};
+
 class Lvk {
 public:
-  Lvk();
+  Lvk(Config config = {});
 
 private:
   // Initialize GLFW
@@ -29,47 +290,151 @@ private:
   // TODO: improve documentation
   void create_logical_device();
   // TODO: improve documentation
-  void create_swap_chain();
+  void create_swap_chain(VkSwapchainKHR old_swap_chain = VK_NULL_HANDLE);
+  // Create a new swap chain (from the current one) with its image views and
+  // framebuffers when the window changes, without waiting for the device:
+  // the old objects are retired until the frames using them are finished
+  void recreate_swap_chain();
+  // Headless replacement of the swap chain: images (and their memory) that are
+  // rendered into without being presented
+  void create_offscreen_images();
   // TODO: improve documentation
   void create_image_views();
   // TODO: improve documentation
-  VkShaderModule create_shader_module(const std::vector<char> &code);
+  // Pipeline cache loaded from `pipeline_cache_dir` (saved by `clean_up()`)
+  void create_pipeline_cache();
   //
   void create_render_pass();
-  //
+  // Pipeline layout and graphics pipeline (a placeholder while the workers
+  // compile the optimized one)
   void create_graphics_pipeline();
+  // Swap in the pipelines that finished compiling (at a frame boundary) and
+  // start the compilation of the changed shaders
+  void update_pipelines();
+  // Watch `shader_source_dir` and start the thread compiling the changes
+  void create_shader_watcher();
+  // Compile the changed shaders and the pipeline using them in the background
+  void reload_shaders();
   //
   void create_framebuffers();
   //
   void create_command_pool();
   //
   void create_command_buffers();
+  // Ring used to upload the meshes (on the transfer queue if any)
+  void create_staging_ring();
+  // Layout of the uniforms of `shader.vert` (both bound with dynamic offsets)
+  void create_descriptor_set_layout();
+  // Uniform ring with its descriptor set, one region per command buffer
+  // submitted in turn (frame context, or swap chain image when cached)
+  void create_uniform_ring();
+  // Write the camera and the transforms of the draw list into `region`
+  void write_uniforms(uint32_t region);
+  // Instance buffer, one region per command buffer submitted in turn
+  void create_instance_buffer();
+  // Pack the identity instances of the draw list and the queued instances
+  // into `region` (one instanced draw per mesh)
+  void write_instances(uint32_t region);
+  // Regions of the uniform ring and of the instance buffer
+  uint32_t get_frame_region_count() const;
+  // Compute pipeline of the GPU-driven draws (if supported)
+  void create_culling_pass();
+  // If the inputs of `culling_scene` are uploaded (culled and drawn)
+  bool is_culling_scene_ready() const;
+  // Draw list, then instanced draws, then GPU-driven draws (one per mesh)
+  size_t get_draw_count() const;
   // TODO: improve documentation
-  void record_command_buffer(VkCommandBuffer command_buffer,
-                             uint32_t image_index);
+  void record_command_buffer(
+      VkCommandBuffer command_buffer, uint32_t image_index,
+      VkQueryPool query_pool,
+      const std::vector<VkCommandBuffer> &secondary_command_buffers = {});
+  // Bind the pipeline and draw a slice of the draw list (and of the
+  // instanced draws and GPU-driven draws after it)
+  void record_draws(VkCommandBuffer command_buffer, size_t first,
+                    size_t count);
+  // Record slices of the draw list in parallel (one per recording thread),
+  // returns the secondary command buffers to execute in order
+  std::vector<VkCommandBuffer>
+  record_secondary_command_buffers(FrameContext &frame, uint32_t image_index,
+                                   VkQueryPool query_pool);
+  // Per frame command pools of the recording threads
+  void create_worker_command_pools();
   //
   void create_sync_objects();
+  // Timestamp queries of each frame in flight (skipped if the graphics queue
+  // does not support timestamps)
+  void create_query_pools();
+  // Timestamp query pool with the queries of every GPU pass
+  VkQueryPool create_timestamp_query_pool();
+  // Read the timestamps of a finished submission
+  void collect_gpu_timings(VkQueryPool query_pool);
+
+  // Command buffers (and query pools) of each swap chain image
+  void create_cached_command_buffers();
+  // Cached command buffers must be recorded again (pipeline, extent or draw
+  // list changed)
+  void invalidate_command_buffers();
+
+  // Wait until the frame `frame_number` is finished by the GPU
+  void wait_for_frame(uint64_t frame_number);
+  // If the frame `frame_number` is finished by the GPU (non-blocking)
+  bool is_frame_finished(uint64_t frame_number);
+  // Wait until at most `max_queued_presents` frames wait to be displayed
+  void wait_for_queued_presents();
+
+  // Destroy resources (with `destroy`) only when the frames already submitted
+  // are finished, since they may still use them, and `delay_frames` more
+  void retire(std::function<void()> destroy, uint64_t delay_frames = 0);
+  // Destroy the retired resources that are no longer used by the GPU
+  void destroy_retired_resources();
+
+  // Called by GLFW when the size of the window framebuffer changes
+  static void framebuffer_resize_callback(GLFWwindow *window, int width,
+                                          int height);
 
 private:
+  Config config;
+
+  // Extensions required from the physical device (depends on `headless`)
+  std::vector<const char *> device_extensions;
+  // Enumerated capabilities (loaded from `capability_cache_path`)
+  utils::capability::CapabilityCache capability_cache;
+
+  /** Host memory of the Vulkan objects */
+  // Outlives every object (`nullptr` if `Config::host_allocator` is false)
+  std::unique_ptr<utils::allocator::HostAllocator> host_allocator;
+  // Passed to every `vkCreate*`/`vkDestroy*` (`nullptr` = driver allocator)
+  const VkAllocationCallbacks *allocator = nullptr;
+
   /** Instance of the application */
   // Instance is the connection between your application and the Vulkan
   VkInstance instance;
   // Debug messenger is used to receive debug messages from the Vulkan
   VkDebugUtilsMessengerEXT debug_messenger;
+  // Receives the validation messages (`nullptr` without validation layers)
+  std::unique_ptr<utils::log::AsyncLogger> debug_logger;
   // Surface is the connection between the window system and the instance
   VkSurfaceKHR surface;
 
   /** Device that is used for the rendering */
   // physical device to interface with the hardware
   VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+  // Properties, features, queue families and extensions of `physical_device`
+  // (queried once when picking it)
+  utils::device::DeviceCapabilities capabilities;
   // logical device to interface with the `physical device`
   VkDevice device;
+  // Memory of the buffers and images (destroyed before `device`)
+  std::unique_ptr<utils::memory::DeviceAllocator> device_allocator;
 
   /** Queues selected of the logical device */
   // Queue of the present device
   VkQueue present_queue;
   // Queue of the logical device
   VkQueue graphics_queue;
+  // Queue of the dedicated transfer family (`VK_NULL_HANDLE` if there is
+  // none or `Config::transfer_queue` is false)
+  VkQueue transfer_queue = VK_NULL_HANDLE;
 
   /** Swap chain */
   // The primary purpose of the swap chain is to synchronize the presentation of
@@ -77,31 +442,180 @@ private:
   // color of the images.
   VkSwapchainKHR swap_chain;
 
-  // Store the handlers
+  // Store the handlers (offscreen images when `headless`)
   std::vector<VkImage> swap_chain_images;
+  // Offscreen images and their memory (empty when presenting to a window)
+  std::vector<utils::memory::Image> offscreen_images;
   std::vector<VkImageView> swap_chain_image_views;
 
   VkFormat swap_chain_image_format;
   VkExtent2D swap_chain_extent;
 
   VkRenderPass render_pass;
+  // `VK_NULL_HANDLE` when `pipeline_cache_dir` is empty
+  VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+  std::string pipeline_cache_path;
+  VkDescriptorSetLayout descriptor_set_layout;
   VkPipelineLayout pipeline_layout;
   VkPipeline graphics_pipeline;
+  // Compiles the pipelines on `pipeline_compile_threads` workers
+  std::unique_ptr<utils::pipeline::PipelineBuilder> pipeline_builder;
+  // Optimized or reloaded `graphics_pipeline` still compiling (invalid once
+  // swapped)
+  utils::pipeline::PipelineHandle pending_graphics_pipeline;
+  utils::pipeline::GraphicsPipelineDescription graphics_pipeline_description;
+
+  /** Hot reload (`nullptr` if disabled) */
+  std::unique_ptr<utils::watch::DirectoryWatcher> shader_watcher;
+  // Compiles the changed shaders and their pipeline
+  std::unique_ptr<utils::thread_pool::ThreadPool> shader_reload_thread;
+  // GLSL file names changed since the last reload
+  std::set<std::string> changed_shaders;
 
   std::vector<VkFramebuffer> swap_chain_framebuffers;
 
   VkCommandPool command_pool;
-  std::vector<VkCommandBuffer> command_buffers;
 
-  std::vector<VkSemaphore> image_available_semaphore;
-  std::vector<VkSemaphore> render_finished_semaphore;
-  std::vector<VkFence> in_flight_fence;
+  /** Frames in flight */
+  // Ring of `config.frames_in_flight` contexts, `current_frame` is the one
+  // that will be recorded by the next `draw_frame()`
+  std::vector<FrameContext> frames;
+  uint32_t current_frame = 0;
+
+  // Set when the window framebuffer is resized (the swap chain must follow)
+  bool framebuffer_resized = false;
+
+  // Commands drawn each frame
+  std::vector<DrawCommand> draw_list = {{}};
+
+  /** Meshes */
+  // Copies the meshes to device local memory, flushed at the start of each
+  // frame
+  std::unique_ptr<utils::staging::StagingRing> staging_ring;
+  // Meshes uploaded by the batches up to this one are drawn (updated at the
+  // start of each frame, the cached command buffers skip the others)
+  uint64_t ready_upload_batch = 0;
+  // Indexed by mesh (destroyed meshes have no buffers)
+  std::vector<utils::mesh::Mesh> meshes;
+
+  /** Uniforms */
+  std::unique_ptr<utils::uniform::UniformRing> uniform_ring;
+  // Pool of `descriptor_set` only, replaced with the ring
+  VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+  // Both blocks in the uniform ring, the offsets are given when bound
+  VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+  Matrix view_projection = IDENTITY_MATRIX;
+  // Dynamic offsets of the frame being recorded (indexed by draw)
+  uint32_t camera_offset = 0;
+  std::vector<uint32_t> object_offsets;
+  // Identity model matrix of the instanced draws
+  uint32_t instanced_object_offset = 0;
+
+  /** Instancing */
+  std::unique_ptr<utils::instance::InstanceBuffer> instance_buffer;
+  // Queued by `draw_instances()` for the next frame, indexed by mesh (emptied
+  // once written, their capacity is kept)
+  std::vector<std::vector<Instance>> pending_instances;
+  // Draws of the frame being recorded (the cached command buffers are
+  // recorded again when they change)
+  std::vector<InstanceDraw> instance_draws;
+
+  /** GPU-driven rendering */
+  // `nullptr` if the device can't draw the culled objects (see
+  // `pick_physical_device()`)
+  std::unique_ptr<utils::culling::CullingPass> culling_pass;
+  // Objects of `set_gpu_objects()` (`nullptr` if none), culled before the
+  // render pass of every frame
+  std::shared_ptr<utils::culling::CullingScene> culling_scene;
+  // Meshes with culled objects, one indirect draw each
+  std::vector<uint32_t> gpu_draw_meshes;
+  // Indexed by mesh (empty = the whole mesh)
+  std::vector<std::vector<MeshLod>> mesh_lods;
+
+  // Indexed by swap chain image (empty if `cache_command_buffers` is off)
+  std::vector<CachedCommandBuffer> cached_command_buffers;
+
+  // Threads recording secondary command buffers (`nullptr` if disabled)
+  std::unique_ptr<utils::thread_pool::ThreadPool> recording_threads;
+
+  /** Frame pacing */
+  // Timeline semaphore enabled (`Config::timeline_semaphore` and supported)
+  bool use_timeline_semaphore = false;
+  utils::sync::TimelineSemaphoreFunctions timeline_semaphore_functions;
+  // Counter = number of the last finished frame
+  VkSemaphore frame_timeline = VK_NULL_HANDLE;
+
+  // Present wait enabled (paced policy and supported)
+  bool use_present_wait = false;
+  PFN_vkWaitForPresentKHR wait_for_present = nullptr;
+  // Present id (frame number) of the first present of the current swap chain
+  uint64_t first_present_id = 1;
+
+  /** Indirect draws */
+  // `set_gpu_objects()` supported (`multiDrawIndirect`,
+  // `drawIndirectFirstInstance` and compute on the graphics queue)
+  bool use_gpu_culling = false;
+  // The GPU writes the number of draws (`VK_KHR_draw_indirect_count`),
+  // otherwise the culled draws are empty
+  bool use_draw_indirect_count = false;
+
+  /** Deferred destruction */
+  // Number of frames submitted and how many of them are known to be finished
+  uint64_t submitted_frames = 0;
+  uint64_t completed_frames = 0;
+  // Resources destroyed once `completed_frames` reaches the number of frames
+  // that were submitted when they were retired (plus their delay), sorted
+  std::deque<std::pair<uint64_t, std::function<void()>>> retired_resources;
+
+  /** GPU timing */
+  // Nanoseconds per timestamp tick
+  float timestamp_period = 0.0f;
+  // 0 if the graphics queue does not support timestamps
+  uint32_t timestamp_valid_bits = 0;
+  // GPU milliseconds of each pass over the last `gpu_timing_window` frames
+  std::vector<utils::timestamp::RollingWindow> gpu_pass_times;
 
 public:
   // Run the application
   void run();
   // Draw the frame
   void draw_frame();
+  // Process the window events (nothing to do when headless)
+  void poll_events();
+  // If the window was closed (never when headless)
+  bool should_close();
+  // Timings of the last `draw_frame()`
+  const FrameTimings &get_frame_timings() const;
+  // GPU time of each pass (empty if timestamps are not supported)
+  std::vector<GpuPassTiming> get_gpu_timings() const;
+  // Replace the commands drawn each frame (throws if their uniforms don't fit
+  // in `Config::uniform_buffer_size`)
+  void set_draw_list(const std::vector<DrawCommand> &draw_list);
+  // Camera of the next frames (no command buffer is recorded again)
+  void set_camera(const Matrix &view_projection);
+  // Minimum severity of the validation layer messages written from now on
+  void set_log_severity(utils::log::Severity severity);
+  // Draw `count` instances of `mesh` in the next `draw_frame()` only (call it
+  // every frame): the instances of a mesh are drawn with one instanced draw,
+  // whatever the number of calls
+  void draw_instances(uint32_t mesh, const Instance *instances, size_t count);
+  // Replace the objects culled by the GPU: they are uploaded once and
+  // culled (and their LOD selected) by a compute pass every frame, the CPU
+  // only records one indirect draw per mesh. Throws if not supported.
+  void set_gpu_objects(const std::vector<GpuObject> &objects);
+  // If `set_gpu_objects()` can be used on the device
+  bool supports_gpu_objects() const;
+  // LODs of `mesh` (at most `utils::culling::max_lods`, the most detailed
+  // first) for the next `set_gpu_objects()` (empty = the whole mesh)
+  void set_mesh_lods(uint32_t mesh, const std::vector<MeshLod> &lods);
+  // Upload a mesh (drawn by the frames started once its copy is done),
+  // returns its index
+  uint32_t create_mesh(const std::vector<Vertex> &vertices,
+                       const std::vector<uint32_t> &indices);
+  // Destroyed once the frames in flight are done with it (throws if it is
+  // still in the draw list, it must not be used by the GPU objects anymore).
+  // Its queued instances are dropped and it can't be drawn anymore.
+  void destroy_mesh(uint32_t mesh);
   // Destroy the vulkan resources and the GLFW
   ~Lvk();
 
@@ -109,8 +623,13 @@ private:
   // Clean up the resources (GLFW and Vulkan)
   void clean_up();
 
-  // Fixed window until the implementation of multiple windows
-  GLFWwindow *window;
+  FrameTimings frame_timings;
+  // Set the frame time and the host allocations of the frame
+  void end_frame_timings(std::chrono::steady_clock::time_point frame_start);
+
+  // Fixed window until the implementation of multiple windows (`nullptr` when
+  // `headless`)
+  GLFWwindow *window = nullptr;
 };
 } // namespace lvk
 
@@ -1,14 +1,104 @@
 #include "Lvk/Lvk.hpp"
+#include <cctype>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 float colors[][4] = {{0.6f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.6f, 0.0f, 1.0f},
                      {0.0f, 0.0f, 0.6f, 1.0f}, {0.6f, 0.6f, 0.0f, 1.0f},
                      {0.0f, 0.6f, 0.6f, 1.0f}, {0.6f, 0.0f, 0.6f, 1.0f},
                      {0.6f, 0.6f, 0.6f, 1.0f}};
 
-int main() {
-  lvk::Lvk app;
+/** Value of the numeric option `arg` (a count, 32 bits) */
+static uint32_t parse_count(const std::string &arg, const char *value) {
+  // `std::stoul` alone accepts a sign, leading spaces, trailing characters
+  // and values that don't fit in 32 bits
+  std::string text = value;
+  size_t end = 0;
+  unsigned long count = 0;
+
+  if (!text.empty() && std::isdigit(static_cast<unsigned char>(text[0]))) {
+    try {
+      count = std::stoul(text, &end);
+    } catch (const std::exception &) {
+      end = 0;
+    }
+  }
+
+  if (end == 0 || end != text.size() || count > UINT32_MAX) {
+    throw std::runtime_error("Invalid value for " + arg + ": " + text);
+  }
+
+  return static_cast<uint32_t>(count);
+}
+
+int main(int argc, char **argv) {
+  lvk::Config config;
+
+  // Usage: Main [--headless] [--frames N] [--frames-in-flight N]
+  //             [--cache-command-buffers] [--recording-threads N]
+  //             [--no-timeline-semaphore]
+  //             [--present-policy latency|power|throughput]
+  //             [--max-queued-presents N] [--pipeline-cache-dir path]
+  //             [--pipeline-threads N] [--shader-dir path] [--hot-reload]
+  //             [--capability-cache path]
+  //             [--log-severity verbose|info|warning|error]
+  //             [--no-host-allocator] [--no-transfer-queue] [--verbose]
+  //             [--trace path]
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+
+      if (arg == "--headless") {
+        config.headless = true;
+      } else if (arg == "--frames" && i + 1 < argc) {
+        config.max_frames = parse_count(arg, argv[++i]);
+      } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+        config.frames_in_flight = parse_count(arg, argv[++i]);
+      } else if (arg == "--cache-command-buffers") {
+        config.cache_command_buffers = true;
+      } else if (arg == "--recording-threads" && i + 1 < argc) {
+        config.recording_threads = parse_count(arg, argv[++i]);
+      } else if (arg == "--no-timeline-semaphore") {
+        config.timeline_semaphore = false;
+      } else if (arg == "--present-policy" && i + 1 < argc) {
+        config.present_policy =
+            utils::swapchain::parse_present_policy(argv[++i]);
+      } else if (arg == "--max-queued-presents" && i + 1 < argc) {
+        config.max_queued_presents = parse_count(arg, argv[++i]);
+      } else if (arg == "--pipeline-cache-dir" && i + 1 < argc) {
+        config.pipeline_cache_dir = argv[++i];
+      } else if (arg == "--pipeline-threads" && i + 1 < argc) {
+        config.pipeline_compile_threads = parse_count(arg, argv[++i]);
+      } else if (arg == "--shader-dir" && i + 1 < argc) {
+        config.shader_dir = argv[++i];
+      } else if (arg == "--hot-reload") {
+        config.hot_reload = true;
+      } else if (arg == "--capability-cache" && i + 1 < argc) {
+        config.capability_cache_path = argv[++i];
+      } else if (arg == "--log-severity" && i + 1 < argc) {
+        config.log_severity = utils::log::parse_severity(argv[++i]);
+      } else if (arg == "--no-host-allocator") {
+        config.host_allocator = false;
+      } else if (arg == "--no-transfer-queue") {
+        config.transfer_queue = false;
+      } else if (arg == "--verbose") {
+        config.verbose = true;
+      } else if (arg == "--trace" && i + 1 < argc) {
+        config.trace_path = argv[++i];
+      } else {
+        std::cerr << "Unknown argument: " << arg << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  lvk::Lvk app(config);
 
   // std::cout << "Adding windows" << std::endl;
   // app.add_window("teste 1", 800, 600);
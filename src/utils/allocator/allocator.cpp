@@ -0,0 +1,331 @@
+#include "allocator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace utils {
+namespace allocator {
+/** Written before every allocation */
+// The header is right before the returned pointer, at the end of a prefix of
+// `max(alignment, 16)` bytes (so the pointer keeps the requested alignment)
+struct Header {
+  // `large_allocation` if not from a size class
+  uint32_t size_class;
+  uint16_t scope;
+  // Bytes between the block and the returned pointer
+  uint16_t prefix;
+  // Requested size
+  uint64_t size;
+};
+static_assert(sizeof(Header) == 16, "the prefix is at least 16 bytes");
+
+static const uint32_t large_allocation = 0xffffffff;
+static const size_t min_block_size = 16;
+static const size_t max_block_size = 4096;
+static const size_t slab_size = 64 * 1024;
+
+static const char *scope_names[HostAllocator::scope_count] = {
+    "command", "object", "cache", "device", "instance"};
+
+static Header *get_header(void *memory) {
+  return reinterpret_cast<Header *>(static_cast<char *>(memory) -
+                                    sizeof(Header));
+}
+
+// Smallest size class holding `size` bytes (`size_class_count` if none)
+static size_t find_size_class(size_t size) {
+  size_t size_class = 0;
+  for (size_t block_size = min_block_size; block_size < size;
+       block_size <<= 1) {
+    ++size_class;
+  }
+
+  return size_class;
+}
+
+static void update_peak(std::atomic<uint64_t> &peak, uint64_t value) {
+  uint64_t current = peak.load(std::memory_order_relaxed);
+  while (value > current &&
+         !peak.compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+HostAllocator::HostAllocator() {
+  this->callbacks.pUserData = this;
+  this->callbacks.pfnAllocation = allocation_callback;
+  this->callbacks.pfnReallocation = reallocation_callback;
+  this->callbacks.pfnFree = free_callback;
+  this->callbacks.pfnInternalAllocation = internal_allocation_callback;
+  this->callbacks.pfnInternalFree = internal_free_callback;
+}
+
+HostAllocator::~HostAllocator() {
+  for (auto &arena : this->arenas) {
+    for (auto &size_class : arena.size_classes) {
+      for (void *slab : size_class.slabs) {
+        std::free(slab);
+      }
+    }
+  }
+}
+
+const VkAllocationCallbacks *HostAllocator::get_callbacks() const {
+  return &this->callbacks;
+}
+
+void HostAllocator::begin_frame() {
+  this->frame_allocations.store(0, std::memory_order_relaxed);
+  this->frame_bytes.store(0, std::memory_order_relaxed);
+}
+
+uint64_t HostAllocator::get_frame_allocations() const {
+  return this->frame_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t HostAllocator::get_frame_bytes() const {
+  return this->frame_bytes.load(std::memory_order_relaxed);
+}
+
+AllocationStatistics
+HostAllocator::get_statistics(VkSystemAllocationScope scope) const {
+  const Arena &arena = this->arenas[std::min<size_t>(scope, scope_count - 1)];
+
+  AllocationStatistics statistics;
+  statistics.live_bytes = arena.live_bytes.load(std::memory_order_relaxed);
+  statistics.peak_bytes = arena.peak_bytes.load(std::memory_order_relaxed);
+  statistics.live_allocations =
+      arena.live_allocations.load(std::memory_order_relaxed);
+  statistics.allocations = arena.allocations.load(std::memory_order_relaxed);
+  statistics.reallocations =
+      arena.reallocations.load(std::memory_order_relaxed);
+  statistics.internal_bytes =
+      arena.internal_bytes.load(std::memory_order_relaxed);
+
+  return statistics;
+}
+
+AllocationStatistics HostAllocator::get_total_statistics() const {
+  AllocationStatistics total;
+  for (size_t i = 0; i < scope_count; ++i) {
+    AllocationStatistics statistics =
+        this->get_statistics(static_cast<VkSystemAllocationScope>(i));
+
+    total.live_bytes += statistics.live_bytes;
+    // Sum of the peaks of each scope (they may not happen at the same time)
+    total.peak_bytes += statistics.peak_bytes;
+    total.live_allocations += statistics.live_allocations;
+    total.allocations += statistics.allocations;
+    total.reallocations += statistics.reallocations;
+    total.internal_bytes += statistics.internal_bytes;
+  }
+
+  return total;
+}
+
+void HostAllocator::print_statistics(std::ostream &out) const {
+  for (size_t i = 0; i < scope_count; ++i) {
+    AllocationStatistics statistics =
+        this->get_statistics(static_cast<VkSystemAllocationScope>(i));
+    if (statistics.allocations == 0 && statistics.internal_bytes == 0) {
+      continue;
+    }
+
+    out << "Host memory (" << scope_names[i] << "): " << statistics.allocations
+        << " allocations, " << statistics.reallocations
+        << " reallocations, peak " << statistics.peak_bytes << " bytes, live "
+        << statistics.live_bytes << " bytes in " << statistics.live_allocations
+        << " allocations" << std::endl;
+  }
+}
+
+void *HostAllocator::allocate(size_t size, size_t alignment,
+                              VkSystemAllocationScope scope) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  size_t scope_index = std::min<size_t>(scope, scope_count - 1);
+  Arena &arena = this->arenas[scope_index];
+
+  size_t prefix = std::max(alignment, sizeof(Header));
+  size_t size_class = find_size_class(prefix + size);
+
+  // A block of a size class is aligned on its size (a power of two), so on
+  // `prefix` too
+  char *block;
+  if (size_class < size_class_count) {
+    block = static_cast<char *>(this->allocate_block(arena, size_class));
+  } else {
+    size_class = large_allocation;
+    size_t total = (prefix + size + prefix - 1) / prefix * prefix;
+    block = static_cast<char *>(std::aligned_alloc(prefix, total));
+  }
+
+  if (block == nullptr) {
+    return nullptr;
+  }
+
+  char *memory = block + prefix;
+  Header *header = get_header(memory);
+  header->size_class = static_cast<uint32_t>(size_class);
+  header->scope = static_cast<uint16_t>(scope_index);
+  header->prefix = static_cast<uint16_t>(prefix);
+  header->size = size;
+
+  uint64_t live_bytes =
+      arena.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  update_peak(arena.peak_bytes, live_bytes);
+  arena.live_allocations.fetch_add(1, std::memory_order_relaxed);
+  arena.allocations.fetch_add(1, std::memory_order_relaxed);
+
+  this->frame_allocations.fetch_add(1, std::memory_order_relaxed);
+  this->frame_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  return memory;
+}
+
+void *HostAllocator::reallocate(void *original, size_t size, size_t alignment,
+                                VkSystemAllocationScope scope) {
+  if (original == nullptr) {
+    return this->allocate(size, alignment, scope);
+  }
+
+  if (size == 0) {
+    this->free(original);
+    return nullptr;
+  }
+
+  Header *header = get_header(original);
+
+  // Still fits in its block (same alignment): nothing to move
+  if (header->size_class != large_allocation &&
+      header->prefix >= alignment &&
+      header->prefix + size <= (min_block_size << header->size_class)) {
+    Arena &arena = this->arenas[header->scope];
+    arena.reallocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (size > header->size) {
+      uint64_t grown = size - header->size;
+      uint64_t live_bytes =
+          arena.live_bytes.fetch_add(grown, std::memory_order_relaxed) + grown;
+      update_peak(arena.peak_bytes, live_bytes);
+    } else {
+      arena.live_bytes.fetch_sub(header->size - size,
+                                 std::memory_order_relaxed);
+    }
+    header->size = size;
+
+    return original;
+  }
+
+  void *memory = this->allocate(size, alignment, scope);
+  if (memory == nullptr) {
+    // The original allocation is left untouched
+    return nullptr;
+  }
+
+  std::memcpy(memory, original, std::min<size_t>(size, header->size));
+  this->free(original);
+
+  this->arenas[std::min<size_t>(scope, scope_count - 1)]
+      .reallocations.fetch_add(1, std::memory_order_relaxed);
+
+  return memory;
+}
+
+void HostAllocator::free(void *memory) {
+  if (memory == nullptr) {
+    return;
+  }
+
+  Header *header = get_header(memory);
+  Arena &arena = this->arenas[header->scope];
+
+  arena.live_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+  arena.live_allocations.fetch_sub(1, std::memory_order_relaxed);
+
+  char *block = static_cast<char *>(memory) - header->prefix;
+  if (header->size_class == large_allocation) {
+    std::free(block);
+  } else {
+    this->free_block(arena, header->size_class, block);
+  }
+}
+
+void *HostAllocator::allocate_block(Arena &arena, size_t size_class) {
+  SizeClass &blocks = arena.size_classes[size_class];
+  size_t block_size = min_block_size << size_class;
+
+  std::lock_guard<std::mutex> lock(blocks.mutex);
+
+  if (blocks.free_list == nullptr) {
+    // Slabs are aligned on the biggest block size
+    char *slab =
+        static_cast<char *>(std::aligned_alloc(max_block_size, slab_size));
+    if (slab == nullptr) {
+      return nullptr;
+    }
+    blocks.slabs.push_back(slab);
+
+    // Link its blocks (the first one ends up at the head)
+    for (size_t offset = slab_size; offset >= block_size;) {
+      offset -= block_size;
+      *reinterpret_cast<void **>(slab + offset) = blocks.free_list;
+      blocks.free_list = slab + offset;
+    }
+  }
+
+  void *block = blocks.free_list;
+  blocks.free_list = *static_cast<void **>(block);
+
+  return block;
+}
+
+void HostAllocator::free_block(Arena &arena, size_t size_class, void *block) {
+  SizeClass &blocks = arena.size_classes[size_class];
+
+  std::lock_guard<std::mutex> lock(blocks.mutex);
+  *static_cast<void **>(block) = blocks.free_list;
+  blocks.free_list = block;
+}
+
+/** Callbacks given to Vulkan (`user_data` is the allocator) */
+VKAPI_ATTR void *VKAPI_CALL
+HostAllocator::allocation_callback(void *user_data, size_t size,
+                                   size_t alignment,
+                                   VkSystemAllocationScope scope) {
+  return static_cast<HostAllocator *>(user_data)->allocate(size, alignment,
+                                                           scope);
+}
+
+VKAPI_ATTR void *VKAPI_CALL HostAllocator::reallocation_callback(
+    void *user_data, void *original, size_t size, size_t alignment,
+    VkSystemAllocationScope scope) {
+  return static_cast<HostAllocator *>(user_data)->reallocate(original, size,
+                                                             alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::free_callback(void *user_data,
+                                                        void *memory) {
+  static_cast<HostAllocator *>(user_data)->free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internal_allocation_callback(
+    void *user_data, size_t size, VkInternalAllocationType /* type */,
+    VkSystemAllocationScope scope) {
+  auto *allocator = static_cast<HostAllocator *>(user_data);
+  allocator->arenas[std::min<size_t>(scope, scope_count - 1)]
+      .internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internal_free_callback(
+    void *user_data, size_t size, VkInternalAllocationType /* type */,
+    VkSystemAllocationScope scope) {
+  auto *allocator = static_cast<HostAllocator *>(user_data);
+  allocator->arenas[std::min<size_t>(scope, scope_count - 1)]
+      .internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+} // namespace allocator
+} // namespace utils
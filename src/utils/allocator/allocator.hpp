@@ -0,0 +1,113 @@
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace utils {
+namespace allocator {
+/** Host allocations of one scope (or of every scope) */
+struct AllocationStatistics {
+  uint64_t live_bytes = 0;
+  uint64_t peak_bytes = 0;
+  uint64_t live_allocations = 0;
+  // Since the creation of the allocator
+  uint64_t allocations = 0;
+  uint64_t reallocations = 0;
+  // Allocated by the driver itself (reported, not made by the allocator)
+  uint64_t internal_bytes = 0;
+};
+
+/** Host memory of the Vulkan objects (`VkAllocationCallbacks`) */
+// One arena per `VkSystemAllocationScope` (command, object, cache, device,
+// instance), so that the short lived allocations don't fragment the long
+// lived ones. An arena hands out power of two size classes (16 B to 4 KiB)
+// from 64 KiB slabs, recycled through free lists. Bigger allocations go to
+// `aligned_alloc`. Thread-safe (a lock per size class).
+class HostAllocator {
+public:
+  HostAllocator();
+  // The slabs are freed: every object must be destroyed before
+  ~HostAllocator();
+
+  HostAllocator(const HostAllocator &) = delete;
+  HostAllocator &operator=(const HostAllocator &) = delete;
+
+  // Passed to the `vkCreate*`/`vkDestroy*` calls (valid while `this` is)
+  const VkAllocationCallbacks *get_callbacks() const;
+
+  // Start counting the allocations of a new frame
+  void begin_frame();
+  // Allocations (and reallocations) since `begin_frame()`, e.g. the driver
+  // allocating while recording or submitting
+  uint64_t get_frame_allocations() const;
+  uint64_t get_frame_bytes() const;
+
+  AllocationStatistics get_statistics(VkSystemAllocationScope scope) const;
+  AllocationStatistics get_total_statistics() const;
+  // One line per scope that allocated something
+  void print_statistics(std::ostream &out) const;
+
+  static const size_t scope_count = 5;
+  static const size_t size_class_count = 9;
+
+private:
+  /** Blocks of one size class */
+  struct SizeClass {
+    std::mutex mutex;
+    // Free blocks, linked through their first bytes
+    void *free_list = nullptr;
+    std::vector<void *> slabs;
+  };
+
+  struct Arena {
+    std::array<SizeClass, size_class_count> size_classes;
+
+    std::atomic<uint64_t> live_bytes{0};
+    std::atomic<uint64_t> peak_bytes{0};
+    std::atomic<uint64_t> live_allocations{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> reallocations{0};
+    std::atomic<uint64_t> internal_bytes{0};
+  };
+
+  VkAllocationCallbacks callbacks{};
+  std::array<Arena, scope_count> arenas;
+
+  std::atomic<uint64_t> frame_allocations{0};
+  std::atomic<uint64_t> frame_bytes{0};
+
+  void *allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+  void *reallocate(void *original, size_t size, size_t alignment,
+                   VkSystemAllocationScope scope);
+  void free(void *memory);
+
+  void *allocate_block(Arena &arena, size_t size_class);
+  void free_block(Arena &arena, size_t size_class, void *block);
+
+  static VKAPI_ATTR void *VKAPI_CALL
+  allocation_callback(void *user_data, size_t size, size_t alignment,
+                      VkSystemAllocationScope scope);
+  static VKAPI_ATTR void *VKAPI_CALL
+  reallocation_callback(void *user_data, void *original, size_t size,
+                        size_t alignment, VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL free_callback(void *user_data,
+                                                  void *memory);
+  static VKAPI_ATTR void VKAPI_CALL internal_allocation_callback(
+      void *user_data, size_t size, VkInternalAllocationType type,
+      VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL internal_free_callback(
+      void *user_data, size_t size, VkInternalAllocationType type,
+      VkSystemAllocationScope scope);
+};
+} // namespace allocator
+} // namespace utils
+
+#endif
@@ -0,0 +1,330 @@
+#include "capability.hpp"
+
+#include "../extension/extension.hpp"
+#include "../layer/layer.hpp"
+#include "../queue/queue.hpp"
+#include "../swapchain/swapchain.hpp"
+#include "../trace/trace.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace utils {
+namespace capability {
+NameSet::NameSet(std::vector<std::string> names) : names(std::move(names)) {
+  std::sort(this->names.begin(), this->names.end());
+  this->names.erase(std::unique(this->names.begin(), this->names.end()),
+                    this->names.end());
+}
+
+bool NameSet::contains(const char *name) const {
+  auto found = std::lower_bound(
+      this->names.begin(), this->names.end(), name,
+      [](const std::string &a, const char *b) { return a.compare(b) < 0; });
+
+  return found != this->names.end() && found->compare(name) == 0;
+}
+
+size_t NameSet::size() const { return this->names.size(); }
+
+const std::vector<std::string> &NameSet::get_names() const {
+  return this->names;
+}
+
+/** Cache file */
+// Header, instance extensions and layers, then the device records. The
+// Vulkan structures are stored as is (same executable, same layout).
+static const char file_magic[4] = {'L', 'V', 'K', 'C'};
+static const uint32_t file_version = 1;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+
+  return hash;
+}
+
+/** Everything that changes what the loader enumerates */
+static uint64_t compute_key() {
+  uint64_t hash = 14695981039346656037ull;
+
+  // `vkEnumerateInstanceVersion` is the loader version (Vulkan 1.1+ loaders)
+  uint32_t loader_version = VK_API_VERSION_1_0;
+  vkEnumerateInstanceVersion(&loader_version);
+  hash = hash_bytes(hash, &loader_version, sizeof(loader_version));
+
+  // Drivers and layers selected by the environment
+  const char *variables[] = {"VK_ICD_FILENAMES",
+                             "VK_DRIVER_FILES",
+                             "VK_ADD_DRIVER_FILES",
+                             "VK_LAYER_PATH",
+                             "VK_ADD_LAYER_PATH",
+                             "VK_INSTANCE_LAYERS",
+                             "VK_LOADER_LAYERS_ENABLE",
+                             "VK_LOADER_LAYERS_DISABLE"};
+  for (const char *variable : variables) {
+    const char *value = std::getenv(variable);
+    std::string entry = std::string(variable) + "=" + (value ? value : "");
+    hash = hash_bytes(hash, entry.data(), entry.size() + 1);
+  }
+
+  // Installing (or updating) a driver or a layer adds or replaces a manifest,
+  // which changes the modification time of its directory
+  std::vector<std::string> roots = {"/etc/vulkan", "/usr/share/vulkan",
+                                    "/usr/local/share/vulkan"};
+  if (const char *home = std::getenv("HOME")) {
+    roots.push_back(std::string(home) + "/.local/share/vulkan");
+  }
+
+  for (const auto &root : roots) {
+    for (const char *directory :
+         {"/icd.d", "/explicit_layer.d", "/implicit_layer.d"}) {
+      struct stat status {};
+      if (stat((root + directory).c_str(), &status) == -1) {
+        status = {};
+      }
+
+      int64_t modified[3] = {static_cast<int64_t>(status.st_ino),
+                             static_cast<int64_t>(status.st_mtim.tv_sec),
+                             static_cast<int64_t>(status.st_mtim.tv_nsec)};
+      hash = hash_bytes(hash, modified, sizeof(modified));
+    }
+  }
+
+  return hash;
+}
+
+/** Serialization helpers */
+template <typename T>
+static void write_value(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void write_names(std::string &out, const NameSet &names) {
+  write_value(out, static_cast<uint32_t>(names.size()));
+  for (const auto &name : names.get_names()) {
+    write_value(out, static_cast<uint32_t>(name.size()));
+    out.append(name);
+  }
+}
+
+/** Reads the file data, `ok` is false once something is missing */
+struct Reader {
+  const std::vector<char> &data;
+  size_t offset = 0;
+  bool ok = true;
+
+  template <typename T> T read() {
+    T value{};
+    if (!this->ok || this->data.size() - this->offset < sizeof(T)) {
+      this->ok = false;
+      return value;
+    }
+
+    std::memcpy(&value, this->data.data() + this->offset, sizeof(T));
+    this->offset += sizeof(T);
+
+    return value;
+  }
+
+  NameSet read_names() {
+    uint32_t count = this->read<uint32_t>();
+
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < count && this->ok; ++i) {
+      uint32_t size = this->read<uint32_t>();
+      if (!this->ok || this->data.size() - this->offset < size) {
+        this->ok = false;
+        break;
+      }
+
+      names.emplace_back(this->data.data() + this->offset, size);
+      this->offset += size;
+    }
+
+    return NameSet(std::move(names));
+  }
+};
+
+CapabilityCache::CapabilityCache(const std::string &path) : path(path) {
+  if (this->path.empty()) {
+    return;
+  }
+
+  utils::trace::Scope scope("utils::capability::CapabilityCache");
+
+  this->key = compute_key();
+  this->load();
+}
+
+void CapabilityCache::load() {
+  std::ifstream file(this->path, std::ios::binary);
+  if (!file.is_open()) {
+    utils::trace::out() << "Capability cache: no file at " << this->path
+                        << std::endl;
+    return;
+  }
+
+  std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+  Reader reader{data};
+
+  char magic[4];
+  for (char &c : magic) {
+    c = reader.read<char>();
+  }
+  uint32_t version = reader.read<uint32_t>();
+  uint64_t key = reader.read<uint64_t>();
+
+  if (!reader.ok || std::memcmp(magic, file_magic, sizeof(magic)) != 0 ||
+      version != file_version || key != this->key) {
+    utils::trace::out() << "Capability cache: outdated file " << this->path
+                        << std::endl;
+    return;
+  }
+
+  InstanceCapabilities instance;
+  instance.extensions = reader.read_names();
+  instance.layers = reader.read_names();
+
+  std::vector<DeviceRecord> devices;
+  uint32_t device_count = reader.read<uint32_t>();
+
+  for (uint32_t i = 0; i < device_count && reader.ok; ++i) {
+    DeviceRecord record;
+    record.vendor_id = reader.read<uint32_t>();
+    record.device_id = reader.read<uint32_t>();
+    record.driver_version = reader.read<uint32_t>();
+    record.extensions = reader.read_names();
+    record.features = reader.read<VkPhysicalDeviceFeatures>();
+
+    uint32_t queue_family_count = reader.read<uint32_t>();
+    for (uint32_t j = 0; j < queue_family_count && reader.ok; ++j) {
+      record.queue_families.push_back(
+          reader.read<VkQueueFamilyProperties>());
+    }
+
+    record.present_wait_features = reader.read<uint8_t>() != 0;
+
+    devices.push_back(std::move(record));
+  }
+
+  // Truncated: enumerate everything again
+  if (!reader.ok) {
+    utils::trace::out() << "Capability cache: invalid file " << this->path
+                        << std::endl;
+    return;
+  }
+
+  this->instance = std::move(instance);
+  this->has_instance = true;
+  this->devices = std::move(devices);
+
+  utils::trace::out() << "Capability cache: loaded " << this->devices.size()
+                      << " devices from " << this->path << std::endl;
+}
+
+const InstanceCapabilities &CapabilityCache::get_instance() {
+  if (!this->has_instance) {
+    this->instance.extensions = NameSet(utils::extension::get_extensions());
+    this->instance.layers = NameSet(utils::layer::get_layers());
+    this->has_instance = true;
+    this->dirty = true;
+  }
+
+  return this->instance;
+}
+
+DeviceRecord
+CapabilityCache::get_device(VkInstance instance,
+                            VkPhysicalDevice physical_device,
+                            const VkPhysicalDeviceProperties &properties) {
+  auto found = std::find_if(
+      this->devices.begin(), this->devices.end(),
+      [&properties](const DeviceRecord &record) {
+        return record.vendor_id == properties.vendorID &&
+               record.device_id == properties.deviceID &&
+               record.driver_version == properties.driverVersion;
+      });
+
+  if (found != this->devices.end()) {
+    return *found;
+  }
+
+  DeviceRecord record;
+  record.vendor_id = properties.vendorID;
+  record.device_id = properties.deviceID;
+  record.driver_version = properties.driverVersion;
+  record.extensions =
+      NameSet(utils::extension::get_device_extensions(physical_device));
+  vkGetPhysicalDeviceFeatures(physical_device, &record.features);
+  record.queue_families = utils::queue::get_queue_families(physical_device);
+  record.present_wait_features = utils::swapchain::supports_present_wait(
+      instance, physical_device, record.extensions);
+
+  this->devices.push_back(record);
+  this->dirty = true;
+
+  return record;
+}
+
+void CapabilityCache::save() {
+  if (this->path.empty() || !this->dirty) {
+    return;
+  }
+
+  std::string out;
+  out.append(file_magic, sizeof(file_magic));
+  write_value(out, file_version);
+  write_value(out, this->key);
+
+  write_names(out, this->get_instance().extensions);
+  write_names(out, this->get_instance().layers);
+
+  write_value(out, static_cast<uint32_t>(this->devices.size()));
+  for (const auto &record : this->devices) {
+    write_value(out, record.vendor_id);
+    write_value(out, record.device_id);
+    write_value(out, record.driver_version);
+    write_names(out, record.extensions);
+    write_value(out, record.features);
+
+    write_value(out, static_cast<uint32_t>(record.queue_families.size()));
+    for (const auto &queue_family : record.queue_families) {
+      write_value(out, queue_family);
+    }
+
+    write_value(out, static_cast<uint8_t>(record.present_wait_features));
+  }
+
+  std::filesystem::path file_path(this->path);
+  if (file_path.has_parent_path()) {
+    std::filesystem::create_directories(file_path.parent_path());
+  }
+
+  // Written next to the file then renamed: a crash never leaves it truncated
+  std::string temporary = this->path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.write(out.data(), out.size())) {
+      throw std::runtime_error("failed to write " + temporary);
+    }
+  }
+  std::filesystem::rename(temporary, this->path);
+
+  this->dirty = false;
+
+  utils::trace::out() << "Capability cache: saved " << this->devices.size()
+                      << " devices to " << this->path << std::endl;
+}
+} // namespace capability
+} // namespace utils
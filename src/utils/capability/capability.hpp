@@ -0,0 +1,81 @@
+#ifndef CAPABILITY_HPP
+#define CAPABILITY_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace utils {
+namespace capability {
+/** Sorted names without duplicates (extensions, layers) */
+// One contiguous array looked up by binary search, instead of a node per name
+class NameSet {
+public:
+  NameSet() = default;
+  explicit NameSet(std::vector<std::string> names);
+
+  bool contains(const char *name) const;
+  size_t size() const;
+  const std::vector<std::string> &get_names() const;
+
+private:
+  std::vector<std::string> names;
+};
+
+/** What the loader reports before an instance exists */
+struct InstanceCapabilities {
+  NameSet extensions;
+  NameSet layers;
+};
+
+/** What a physical device reports, independently of the surface */
+struct DeviceRecord {
+  // Key of the record (a driver update enumerates the device again)
+  uint32_t vendor_id = 0;
+  uint32_t device_id = 0;
+  uint32_t driver_version = 0;
+
+  NameSet extensions;
+  VkPhysicalDeviceFeatures features{};
+  std::vector<VkQueueFamilyProperties> queue_families;
+  // `presentId` and `presentWait` features (false without the extensions)
+  bool present_wait_features = false;
+};
+
+/** Enumerated capabilities, kept in a file between runs */
+// The file is ignored when the loader version, the Vulkan environment
+// variables or the driver/layer manifest directories changed.
+class CapabilityCache {
+public:
+  // Load `path` ("" = enumerate every run, nothing is saved)
+  explicit CapabilityCache(const std::string &path);
+
+  // Cached, or enumerated (and cached) on a miss
+  const InstanceCapabilities &get_instance();
+  DeviceRecord get_device(VkInstance instance, VkPhysicalDevice physical_device,
+                          const VkPhysicalDeviceProperties &properties);
+
+  // Write the file when something was enumerated (throws if it fails)
+  void save();
+
+private:
+  std::string path;
+  // Loader version and environment the capabilities were enumerated with
+  uint64_t key = 0;
+
+  bool has_instance = false;
+  InstanceCapabilities instance;
+  std::vector<DeviceRecord> devices;
+
+  // Something was enumerated since the file was loaded
+  bool dirty = false;
+
+  void load();
+};
+} // namespace capability
+} // namespace utils
+
+#endif
@@ -0,0 +1,319 @@
+#include "culling.hpp"
+
+#include "../pipeline/pipeline.hpp"
+
+#include <stdexcept>
+
+namespace utils {
+namespace culling {
+// Threads per workgroup (`local_size_x` of `cull.comp`)
+static const uint32_t workgroup_size = 64;
+
+/** Storage buffers of a scene (set 1 of `cull.comp`) */
+enum Binding : uint32_t {
+  BINDING_OBJECTS = 0,
+  BINDING_MESHES,
+  BINDING_COMMANDS,
+  BINDING_INSTANCES,
+  BINDING_COUNTS,
+  BINDING_COUNT
+};
+
+CullingPass::CullingPass(VkDevice device,
+                         memory::DeviceAllocator &device_allocator,
+                         VkPipelineCache pipeline_cache,
+                         VkDescriptorSetLayout uniform_layout,
+                         bool draw_indirect_count,
+                         const VkAllocationCallbacks *allocator)
+    : device(device), device_allocator(device_allocator),
+      allocator(allocator), draw_indirect_count(draw_indirect_count) {
+  /** Set 1: the buffers of a scene */
+  VkDescriptorSetLayoutBinding bindings[BINDING_COUNT]{};
+  for (uint32_t i = 0; i < BINDING_COUNT; ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layout_info{};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = BINDING_COUNT;
+  layout_info.pBindings = bindings;
+
+  if (vkCreateDescriptorSetLayout(device, &layout_info, allocator,
+                                  &this->descriptor_set_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create culling descriptor set "
+                             "layout!");
+  }
+
+  /** Pipeline layout: the camera (set 0) and the scene (set 1) */
+  VkDescriptorSetLayout set_layouts[] = {uniform_layout,
+                                         this->descriptor_set_layout};
+
+  // Number of objects (the last workgroup is partial)
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(uint32_t);
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info{};
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 2;
+  pipeline_layout_info.pSetLayouts = set_layouts;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+  if (vkCreatePipelineLayout(device, &pipeline_layout_info, allocator,
+                             &this->pipeline_layout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create culling pipeline layout!");
+  }
+
+  this->pipeline = pipeline::create_compute_pipeline(
+      device, pipeline_cache, "cull.comp", this->pipeline_layout, allocator);
+
+  if (draw_indirect_count) {
+    this->draw_indexed_indirect_count =
+        reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+    if (this->draw_indexed_indirect_count == nullptr) {
+      throw std::runtime_error(
+          "failed to load vkCmdDrawIndexedIndirectCountKHR!");
+    }
+  }
+}
+
+CullingPass::~CullingPass() {
+  vkDestroyPipeline(this->device, this->pipeline, this->allocator);
+  vkDestroyPipelineLayout(this->device, this->pipeline_layout,
+                          this->allocator);
+  vkDestroyDescriptorSetLayout(this->device, this->descriptor_set_layout,
+                               this->allocator);
+}
+
+std::shared_ptr<CullingScene>
+CullingPass::create_scene(staging::StagingRing &staging_ring,
+                          const std::vector<GpuObject> &objects,
+                          std::vector<GpuMesh> meshes) {
+  if (objects.empty() || meshes.empty()) {
+    throw std::runtime_error("culling scene without objects or meshes!");
+  }
+
+  auto scene = std::make_shared<CullingScene>();
+  scene->object_count = static_cast<uint32_t>(objects.size());
+
+  /** Segments of the meshes: one slot per object */
+  scene->command_counts.assign(meshes.size(), 0);
+  for (const auto &object : objects) {
+    if (object.mesh >= meshes.size()) {
+      throw std::runtime_error("culled object of an unknown mesh!");
+    }
+    ++scene->command_counts[object.mesh];
+  }
+
+  scene->first_commands.resize(meshes.size());
+  uint32_t first_command = 0;
+  for (size_t mesh = 0; mesh < meshes.size(); ++mesh) {
+    if (meshes[mesh].lod_count == 0 || meshes[mesh].lod_count > max_lods) {
+      throw std::runtime_error("invalid number of mesh LODs!");
+    }
+    scene->first_commands[mesh] = first_command;
+    meshes[mesh].first_command = first_command;
+    first_command += scene->command_counts[mesh];
+  }
+
+  /** Buffers */
+  auto create_buffer = [this](VkDeviceSize size, VkBufferUsageFlags usage) {
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    return this->device_allocator.create_buffer(
+        buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  };
+
+  VkDeviceSize objects_size = objects.size() * sizeof(GpuObject);
+  VkDeviceSize meshes_size = meshes.size() * sizeof(GpuMesh);
+  VkDeviceSize commands_size =
+      objects.size() * sizeof(VkDrawIndexedIndirectCommand);
+  VkDeviceSize instances_size = objects.size() * sizeof(GpuInstance);
+  VkDeviceSize counts_size = meshes.size() * sizeof(uint32_t);
+
+  scene->objects =
+      create_buffer(objects_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  scene->meshes =
+      create_buffer(meshes_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  // Zeroed by `vkCmdFillBuffer` (the counts, or the commands without
+  // `VK_KHR_draw_indirect_count`)
+  scene->commands =
+      create_buffer(commands_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  scene->instances =
+      create_buffer(instances_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  scene->counts =
+      create_buffer(counts_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+  staging_ring.upload(scene->objects.buffer, 0, objects.data(), objects_size);
+  scene->upload_batch = staging_ring.upload(scene->meshes.buffer, 0,
+                                            meshes.data(), meshes_size);
+
+  /** Descriptor set */
+  VkDescriptorPoolSize pool_size{};
+  pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  pool_size.descriptorCount = BINDING_COUNT;
+
+  VkDescriptorPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+
+  if (vkCreateDescriptorPool(this->device, &pool_info, this->allocator,
+                             &scene->descriptor_pool) != VK_SUCCESS) {
+    this->destroy_scene(*scene);
+    throw std::runtime_error("failed to create culling descriptor pool!");
+  }
+
+  VkDescriptorSetAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = scene->descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &this->descriptor_set_layout;
+
+  if (vkAllocateDescriptorSets(this->device, &alloc_info,
+                               &scene->descriptor_set) != VK_SUCCESS) {
+    this->destroy_scene(*scene);
+    throw std::runtime_error("failed to allocate culling descriptor set!");
+  }
+
+  const memory::Buffer *buffers[BINDING_COUNT] = {
+      &scene->objects, &scene->meshes, &scene->commands, &scene->instances,
+      &scene->counts};
+
+  VkDescriptorBufferInfo buffer_infos[BINDING_COUNT]{};
+  VkWriteDescriptorSet writes[BINDING_COUNT]{};
+  for (uint32_t i = 0; i < BINDING_COUNT; ++i) {
+    buffer_infos[i].buffer = buffers[i]->buffer;
+    buffer_infos[i].offset = 0;
+    buffer_infos[i].range = VK_WHOLE_SIZE;
+
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = scene->descriptor_set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &buffer_infos[i];
+  }
+
+  vkUpdateDescriptorSets(this->device, BINDING_COUNT, writes, 0, nullptr);
+
+  return scene;
+}
+
+void CullingPass::destroy_scene(const CullingScene &scene) {
+  if (scene.descriptor_pool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(this->device, scene.descriptor_pool,
+                            this->allocator);
+  }
+
+  for (const memory::Buffer *buffer :
+       {&scene.objects, &scene.meshes, &scene.commands, &scene.instances,
+        &scene.counts}) {
+    if (buffer->buffer != VK_NULL_HANDLE) {
+      this->device_allocator.destroy_buffer(*buffer);
+    }
+  }
+}
+
+void CullingPass::record_cull(VkCommandBuffer command_buffer,
+                              const CullingScene &scene,
+                              VkDescriptorSet uniform_set,
+                              const uint32_t *dynamic_offsets) {
+  // The outputs are rewritten: the draws of the previous frame must be done
+  // reading them, and its culling done writing them
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  // The shader appends to the segments from their start
+  vkCmdFillBuffer(command_buffer, scene.counts.buffer, 0, VK_WHOLE_SIZE, 0);
+  // Every command is drawn, the culled ones must be empty
+  if (!this->draw_indirect_count) {
+    vkCmdFillBuffer(command_buffer, scene.commands.buffer, 0, VK_WHOLE_SIZE,
+                    0);
+  }
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  /** Culling (one thread per object) */
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    this->pipeline);
+
+  VkDescriptorSet sets[] = {uniform_set, scene.descriptor_set};
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          this->pipeline_layout, 0, 2, sets, 2,
+                          dynamic_offsets);
+  vkCmdPushConstants(command_buffer, this->pipeline_layout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t),
+                     &scene.object_count);
+
+  vkCmdDispatch(command_buffer,
+                (scene.object_count + workgroup_size - 1) / workgroup_size, 1,
+                1);
+
+  // The draws read the commands, the counts and the instances
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                          VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void CullingPass::record_draws(VkCommandBuffer command_buffer,
+                               const CullingScene &scene, uint32_t mesh) {
+  if (mesh >= scene.command_counts.size() ||
+      scene.command_counts[mesh] == 0) {
+    return;
+  }
+
+  VkDeviceSize offset =
+      scene.first_commands[mesh] * sizeof(VkDrawIndexedIndirectCommand);
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+  // At most one draw per object of the mesh, the count is the visible ones
+  if (this->draw_indirect_count) {
+    this->draw_indexed_indirect_count(
+        command_buffer, scene.commands.buffer, offset, scene.counts.buffer,
+        mesh * sizeof(uint32_t), scene.command_counts[mesh], stride);
+  } else {
+    vkCmdDrawIndexedIndirect(command_buffer, scene.commands.buffer, offset,
+                             scene.command_counts[mesh], stride);
+  }
+}
+} // namespace culling
+} // namespace utils
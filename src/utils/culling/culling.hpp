@@ -0,0 +1,137 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../memory/memory.hpp"
+#include "../staging/staging.hpp"
+
+namespace utils {
+namespace culling {
+// Levels of detail of a mesh at most (`Mesh::lods` of `cull.comp`)
+const uint32_t max_lods = 4;
+
+/** `Object` of `cull.comp` (std430), one per culled object */
+struct GpuObject {
+  float translation[2] = {0.0f, 0.0f};
+  float rotation = 0.0f;
+  float scale = 1.0f;
+  uint32_t mesh = 0;
+  // Bounding circle around the origin of the mesh (before the scale)
+  float radius = 1.0f;
+  uint32_t padding[2] = {0, 0};
+};
+
+/** `Instance` of `cull.comp`, read as the instance attributes of the
+ * graphics pipeline */
+struct GpuInstance {
+  float translation[2];
+  float rotation;
+  float scale;
+};
+
+/** `Lod` of `cull.comp`: range of the indices of a mesh */
+struct GpuLod {
+  uint32_t first_index = 0;
+  uint32_t index_count = 0;
+  // Drawn while the projected radius (NDC) is at least this, otherwise the
+  // next LOD is tried (the last one is drawn whatever the radius)
+  float min_screen_radius = 0.0f;
+  int32_t vertex_offset = 0;
+};
+
+/** `Mesh` of `cull.comp` (std430) */
+struct GpuMesh {
+  // First command (and instance) of the mesh in the outputs, set by
+  // `CullingPass::create_scene()`
+  uint32_t first_command = 0;
+  // At least 1, the most detailed first
+  uint32_t lod_count = 1;
+  uint32_t padding[2] = {0, 0};
+  GpuLod lods[max_lods];
+};
+
+/** Objects culled together and the outputs of their culling */
+// Each mesh owns a contiguous segment of commands (and instances), one slot
+// per object of the mesh: the visible objects are appended to the segment of
+// their mesh, its count is the number of draws.
+struct CullingScene {
+  // Read by the compute pass (uploaded through the staging ring)
+  memory::Buffer objects;
+  memory::Buffer meshes;
+  // Written by the compute pass every frame
+  memory::Buffer commands;
+  memory::Buffer instances;
+  memory::Buffer counts;
+
+  // Pool of `descriptor_set` only (set 1 of the compute pipeline)
+  VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+
+  uint32_t object_count = 0;
+  // Indexed by mesh: segment of its commands
+  std::vector<uint32_t> first_commands;
+  std::vector<uint32_t> command_counts;
+
+  // Staging batch of the inputs (not culled before it is ready)
+  uint64_t upload_batch = 0;
+};
+
+/** Frustum culling and LOD selection of the objects on the GPU */
+// The compute pass writes `VkDrawIndexedIndirectCommand`s and the number of
+// draws of each mesh, so the CPU records the same few commands whatever the
+// number of objects (and the cached command buffers are never recorded
+// again when the camera moves).
+class CullingPass {
+public:
+  // `uniform_layout` is set 0 (the camera at binding 0, both bindings bound
+  // with dynamic offsets). Without `draw_indirect_count`
+  // (`VK_KHR_draw_indirect_count`), every command of a segment is drawn
+  // (`multiDrawIndirect`) and the unused ones are zeroed each frame.
+  CullingPass(VkDevice device, memory::DeviceAllocator &device_allocator,
+              VkPipelineCache pipeline_cache,
+              VkDescriptorSetLayout uniform_layout, bool draw_indirect_count,
+              const VkAllocationCallbacks *allocator);
+  ~CullingPass();
+
+  CullingPass(const CullingPass &) = delete;
+  CullingPass &operator=(const CullingPass &) = delete;
+
+  // Buffers of `objects` (their meshes index `meshes`), uploaded through
+  // `staging_ring`. Destroyed with `destroy_scene()`, once no frame uses it.
+  std::shared_ptr<CullingScene> create_scene(
+      staging::StagingRing &staging_ring,
+      const std::vector<GpuObject> &objects, std::vector<GpuMesh> meshes);
+  void destroy_scene(const CullingScene &scene);
+
+  // Outside of a render pass: reset the counts, cull with the camera of
+  // `uniform_set` (its 2 `dynamic_offsets`) and make the outputs visible to
+  // the draws
+  void record_cull(VkCommandBuffer command_buffer, const CullingScene &scene,
+                   VkDescriptorSet uniform_set,
+                   const uint32_t *dynamic_offsets);
+  // Draw the visible objects of `mesh`, with the buffers of the mesh and the
+  // instances of the scene (binding 1) bound
+  void record_draws(VkCommandBuffer command_buffer, const CullingScene &scene,
+                    uint32_t mesh);
+
+private:
+  VkDevice device;
+  memory::DeviceAllocator &device_allocator;
+  const VkAllocationCallbacks *allocator;
+
+  VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  bool draw_indirect_count;
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count = nullptr;
+};
+} // namespace culling
+} // namespace utils
+
+#endif
@@ -1,60 +1,167 @@
 #include "device.hpp"
 
 #include "../extension/extension.hpp"
-#include "../queue/queue.hpp"
 #include "../swapchain/swapchain.hpp"
+#include "../sync/sync.hpp"
+#include "../trace/trace.hpp"
 
-#include <iostream>
-#include <set>
-#include <string>
+#include <algorithm>
 
 namespace utils {
 namespace device {
-bool is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface,
-                        std::vector<const char *> &device_extensions) {
+DeviceCapabilities
+query_device_capabilities(capability::CapabilityCache &cache,
+                          VkInstance instance, VkPhysicalDevice physical_device,
+                          VkSurfaceKHR surface,
+                          const std::vector<const char *> &device_extensions) {
+  utils::trace::Scope scope("utils::device::query_device_capabilities");
+
+  DeviceCapabilities capabilities;
+  capabilities.physical_device = physical_device;
+
   /** Hardware specifications */
-  VkPhysicalDeviceProperties device_properties;
-  vkGetPhysicalDeviceProperties(device, &device_properties);
+  // The properties are the key of the cached record
+  vkGetPhysicalDeviceProperties(physical_device, &capabilities.properties);
+  capability::DeviceRecord record =
+      cache.get_device(instance, physical_device, capabilities.properties);
+  capabilities.features = record.features;
+  vkGetPhysicalDeviceMemoryProperties(physical_device,
+                                      &capabilities.memory_properties);
 
-  VkPhysicalDeviceFeatures device_features;
-  vkGetPhysicalDeviceFeatures(device, &device_features);
+  for (uint32_t i = 0; i < capabilities.memory_properties.memoryHeapCount;
+       ++i) {
+    const VkMemoryHeap &heap = capabilities.memory_properties.memoryHeaps[i];
 
-  /** Device extension support */
-  std::set<std::string> available_device_extensions =
-      utils::extension::get_device_extensions(device);
+    if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      capabilities.device_local_memory =
+          std::max(capabilities.device_local_memory, heap.size);
+    }
+  }
 
   /** Graphics family and Presentation family */
-  QueueFamilyIndices indices = queue::find_queue_families(device, surface);
-  bool extension_supported = extension::check_device_extensions(
-      available_device_extensions, device_extensions);
+  // The present support depends on the surface, so it is never cached
+  capabilities.queue_families = std::move(record.queue_families);
+  capabilities.queue_family_indices = queue::find_queue_families(
+      physical_device, surface, capabilities.queue_families);
+
+  /** Device extension support */
+  capabilities.extensions = std::move(record.extensions);
+
+  capabilities.timeline_semaphore =
+      utils::sync::supports_timeline_semaphore(capabilities.extensions);
+  capabilities.present_wait =
+      surface != VK_NULL_HANDLE && record.present_wait_features;
+  capabilities.draw_indirect_count = capabilities.extensions.contains(
+      VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
 
-  // Physical device extensions
-  std::cout << "Device: " << device_properties.deviceName << std::endl;
-  std::cout << "Device extensions: " << std::endl;
-  for (const auto &extension : available_device_extensions) {
-    std::cout << "\t" << extension << std::endl;
+  if (is_device_suitable(capabilities, surface, device_extensions)) {
+    capabilities.score = score_device(capabilities);
   }
 
-  // Required extensions
-  std::cout << "Extensions required:" << std::endl;
-  for (const auto &extension : device_extensions) {
-    std::cout << "\t" << extension << std::endl;
+  utils::trace::out() << "Device: " << capabilities.properties.deviceName
+                      << " (type " << capabilities.properties.deviceType
+                      << ", " << capabilities.extensions.size()
+                      << " extensions, score " << capabilities.score << ")"
+                      << std::endl;
+
+  return capabilities;
+}
+
+bool is_device_suitable(const DeviceCapabilities &capabilities,
+                        VkSurfaceKHR surface,
+                        const std::vector<const char *> &device_extensions) {
+  bool extension_supported = extension::check_device_extensions(
+      capabilities.extensions, device_extensions);
+
+  // Wireframe polygon mode of the rasterizer
+  if (!capabilities.features.fillModeNonSolid) {
+    utils::trace::out() << "Feature fillModeNonSolid not supported"
+                        << std::endl;
+    return false;
   }
 
-  // Check if the device support the extensions
-  std::cout << "Extensions supported? " << extension_supported << std::endl;
+  /** Headless: no surface, so no present support nor swap chain needed */
+  if (surface == VK_NULL_HANDLE) {
+    return capabilities.queue_family_indices.is_complete_headless() &&
+           extension_supported;
+  }
 
   /** Swap chain support (Verify only if has the swapchain extension) */
   bool swap_chain_adequate = false;
   if (extension_supported) {
     SwapChainSupportDetails swap_chain_support =
-        utils::swapchain::query_swap_chain_support(surface, device);
+        utils::swapchain::query_swap_chain_support(
+            surface, capabilities.physical_device);
 
     swap_chain_adequate = !swap_chain_support.formats.empty() &&
                           !swap_chain_support.present_modes.empty();
   }
 
-  return indices.is_complete() && extension_supported && swap_chain_adequate;
+  return capabilities.queue_family_indices.is_complete() &&
+         extension_supported && swap_chain_adequate;
+}
+
+uint64_t score_device(const DeviceCapabilities &capabilities) {
+  // Bits 56-63: device type
+  uint64_t type_rank = 1;
+  switch (capabilities.properties.deviceType) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    type_rank = 5;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    type_rank = 4;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    type_rank = 3;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_CPU:
+    type_rank = 2;
+    break;
+  default:
+    break;
+  }
+
+  // Bits 48-55: optional features
+  uint64_t features = 0;
+  features += capabilities.timeline_semaphore ? 1 : 0;
+  features += capabilities.present_wait ? 1 : 0;
+
+  // Bits 16-47: device local memory (MiB)
+  uint64_t memory_mib =
+      std::min<uint64_t>(capabilities.device_local_memory >> 20, 0xffffffff);
+
+  // Bits 0-15: maximum 2D image size (in 16 pixels)
+  uint64_t image_size = std::min<uint64_t>(
+      capabilities.properties.limits.maxImageDimension2D / 16, 0xffff);
+
+  return (type_rank << 56) | (features << 48) | (memory_mib << 16) |
+         image_size;
+}
+
+DeviceCapabilities
+pick_best_device(capability::CapabilityCache &cache, VkInstance instance,
+                 VkSurfaceKHR surface,
+                 const std::vector<const char *> &device_extensions) {
+  uint32_t device_count = 0;
+  vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+
+  std::vector<VkPhysicalDevice> devices(device_count);
+  vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+
+  utils::trace::out() << "Number of physical devices: " << device_count
+                      << std::endl;
+
+  DeviceCapabilities best;
+  for (const auto &device : devices) {
+    DeviceCapabilities capabilities = query_device_capabilities(
+        cache, instance, device, surface, device_extensions);
+
+    if (capabilities.score > best.score) {
+      best = std::move(capabilities);
+    }
+  }
+
+  return best;
 }
 } // namespace device
 } // namespace utils
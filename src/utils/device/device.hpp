@@ -3,12 +3,67 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <cstdint>
+#include <string>
 #include <vector>
 
+#include "../capability/capability.hpp"
+#include "../queue/queue.hpp"
+
 namespace utils {
 namespace device {
-bool is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface,
-                        std::vector<const char *> &device_extensions);
+/** Everything the engine needs to know about a physical device, queried once
+ * (the driver answers are the same for the whole run) */
+struct DeviceCapabilities {
+  VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+
+  VkPhysicalDeviceProperties properties{};
+  VkPhysicalDeviceFeatures features{};
+  VkPhysicalDeviceMemoryProperties memory_properties{};
+
+  std::vector<VkQueueFamilyProperties> queue_families;
+  QueueFamilyIndices queue_family_indices;
+
+  capability::NameSet extensions;
+
+  /** Optional features */
+  bool timeline_semaphore = false;
+  // `VK_KHR_present_id` + `VK_KHR_present_wait` (false when headless)
+  bool present_wait = false;
+  // `VK_KHR_draw_indirect_count` (core in Vulkan 1.2, the app targets 1.0)
+  bool draw_indirect_count = false;
+
+  // Size of the largest device local heap (bytes)
+  VkDeviceSize device_local_memory = 0;
+
+  // Higher is better (see `score_device()`), 0 if not suitable
+  uint64_t score = 0;
+};
+
+// Query the capabilities of `physical_device` (and its score), the ones that
+// don't depend on the surface come from `cache`
+DeviceCapabilities
+query_device_capabilities(capability::CapabilityCache &cache,
+                          VkInstance instance, VkPhysicalDevice physical_device,
+                          VkSurfaceKHR surface,
+                          const std::vector<const char *> &device_extensions);
+
+bool is_device_suitable(const DeviceCapabilities &capabilities,
+                        VkSurfaceKHR surface,
+                        const std::vector<const char *> &device_extensions);
+
+// Order of preference between suitable devices: device type first (discrete
+// GPU > integrated > virtual > CPU), then the optional features, then the
+// device local memory and the maximum 2D image size
+uint64_t score_device(const DeviceCapabilities &capabilities);
+
+// Suitable device with the highest score (the first enumerated on a tie, so
+// the pick is the same on every run), `physical_device` is `VK_NULL_HANDLE` if
+// none is suitable
+DeviceCapabilities
+pick_best_device(capability::CapabilityCache &cache, VkInstance instance,
+                 VkSurfaceKHR surface,
+                 const std::vector<const char *> &device_extensions);
 } // namespace device
 } // namespace utils
 
@@ -1,14 +1,12 @@
 #include "extension.hpp"
 
-#include <iostream>
-#include <set>
+#include "../trace/trace.hpp"
+
 #include <string>
 #include <vector>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-std::set<std::string> extensions_available;
-
 /** It's not the ideal form, but it works for now */
 #ifdef NDEBUG
 const bool enable_validation_layer = false;
@@ -18,7 +16,9 @@ const bool enable_validation_layer = true;
 
 namespace utils {
 namespace extension {
-void get_extensions() {
+std::vector<std::string> get_extensions() {
+  utils::trace::Scope scope("utils::extension::get_extensions");
+
   uint32_t extensionCount = 0;
   vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
 
@@ -26,27 +26,44 @@ void get_extensions() {
   vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount,
                                          extensions.data());
 
+  std::vector<std::string> extensions_available;
   for (const auto &extension : extensions) {
-    extensions_available.insert(extension.extensionName);
+    extensions_available.push_back(extension.extensionName);
   }
+
+  return extensions_available;
 }
-std::set<std::string> get_device_extensions(VkPhysicalDevice physical_device) {
+std::vector<std::string>
+get_device_extensions(VkPhysicalDevice physical_device) {
+  utils::trace::Scope scope("utils::extension::get_device_extensions");
+
   uint32_t extensionCount;
   vkEnumerateDeviceExtensionProperties(physical_device, nullptr,
                                        &extensionCount, nullptr);
 
-  std::set<std::string> device_extensions;
+  std::vector<std::string> device_extensions;
 
   std::vector<VkExtensionProperties> availableExtensions(extensionCount);
   vkEnumerateDeviceExtensionProperties(
       physical_device, nullptr, &extensionCount, availableExtensions.data());
 
   for (const auto &extension : availableExtensions) {
-    device_extensions.insert(extension.extensionName);
+    device_extensions.push_back(extension.extensionName);
   }
 
   return device_extensions;
 }
+/** Extensions needed by the engine itself (with or without a window) */
+static void add_engine_extensions(std::vector<const char *> &extensions) {
+  if (enable_validation_layer) {
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  }
+
+  // Enabled for wiremode on the rasterizer
+  // https://docs.vulkan.org/spec/latest/appendices/extensions.html#VK_KHR_get_physical_device_properties2
+  extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+}
+
 std::vector<const char *> get_window_extensions() {
   uint32_t glfwExtensionCount = 0;
   const char **glfwExtensions;
@@ -57,22 +74,27 @@ std::vector<const char *> get_window_extensions() {
   std::vector<const char *> extensions(glfwExtensions,
                                        glfwExtensions + glfwExtensionCount);
 
-  if (enable_validation_layer) {
-    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-  }
+  add_engine_extensions(extensions);
 
-  // Enabled for wiremode on the rasterizer
-  // https://docs.vulkan.org/spec/latest/appendices/extensions.html#VK_KHR_get_physical_device_properties2
-  extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  return extensions;
+}
+
+std::vector<const char *> get_headless_extensions() {
+  // Without a window there is no surface, so no `VK_KHR_surface` (or platform
+  // specific surface extension) is required
+  std::vector<const char *> extensions;
+
+  add_engine_extensions(extensions);
 
   return extensions;
 }
 
-bool check_extensions(const std::vector<const char *> &extensions) {
+bool check_extensions(const capability::NameSet &extensions_available,
+                      const std::vector<const char *> &extensions) {
   for (size_t i = 0; i < extensions.size(); ++i) {
-    if (extensions_available.find(extensions[i]) ==
-        extensions_available.end()) {
-      std::cout << "Extension " << extensions[i] << " not found" << std::endl;
+    if (!extensions_available.contains(extensions[i])) {
+      utils::trace::out() << "Extension " << extensions[i] << " not found"
+                          << std::endl;
       return false;
     }
   }
@@ -81,12 +103,12 @@ bool check_extensions(const std::vector<const char *> &extensions) {
 }
 
 bool check_device_extensions(
-    const std::set<std::string> &device_extensions_available,
+    const capability::NameSet &device_extensions_available,
     const std::vector<const char *> &extensions) {
   for (size_t i = 0; i < extensions.size(); ++i) {
-    if (device_extensions_available.find(extensions[i]) ==
-        device_extensions_available.end()) {
-      std::cout << "Extension " << extensions[i] << " not found" << std::endl;
+    if (!device_extensions_available.contains(extensions[i])) {
+      utils::trace::out() << "Extension " << extensions[i] << " not found"
+                          << std::endl;
       return false;
     }
   }
@@ -4,19 +4,24 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#include <set>
 #include <string>
 #include <vector>
 
+#include "../capability/capability.hpp"
+
 namespace utils {
 namespace extension {
-void get_extensions();
-std::set<std::string> get_device_extensions(VkPhysicalDevice physical_device);
+// Enumerate (see `utils::capability::CapabilityCache` for the cached ones)
+std::vector<std::string> get_extensions();
+std::vector<std::string>
+get_device_extensions(VkPhysicalDevice physical_device);
 std::vector<const char *> get_window_extensions();
+std::vector<const char *> get_headless_extensions();
 
-bool check_extensions(const std::vector<const char *> &extensions);
+bool check_extensions(const capability::NameSet &extensions_available,
+                      const std::vector<const char *> &extensions);
 bool check_device_extensions(
-    const std::set<std::string> &device_extensions_available,
+    const capability::NameSet &device_extensions_available,
     const std::vector<const char *> &extensions);
 } // namespace extension
 } // namespace utils
@@ -0,0 +1,65 @@
+#include "instance.hpp"
+
+#include <stdexcept>
+
+namespace utils {
+namespace instance {
+// Smallest buffer, so that a few instances don't recreate it every frame
+static const VkDeviceSize min_buffer_size = 64 * 1024;
+
+InstanceBuffer::InstanceBuffer(memory::DeviceAllocator &device_allocator,
+                               uint32_t region_count)
+    : device_allocator(device_allocator), buffers(region_count) {}
+
+InstanceBuffer::~InstanceBuffer() {
+  for (const auto &buffer : this->buffers) {
+    if (buffer.buffer != VK_NULL_HANDLE) {
+      this->device_allocator.destroy_buffer(buffer);
+    }
+  }
+}
+
+bool InstanceBuffer::begin_region(uint32_t region, VkDeviceSize size) {
+  if (region >= this->buffers.size()) {
+    throw std::runtime_error("instance buffer region out of range!");
+  }
+  this->region = region;
+
+  memory::Buffer &buffer = this->buffers[region];
+  if (buffer.buffer != VK_NULL_HANDLE && size <= buffer.allocation.size) {
+    return false;
+  }
+
+  // Doubled, so that a growing scene recreates it a few times only
+  VkDeviceSize capacity = min_buffer_size;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+
+  if (buffer.buffer != VK_NULL_HANDLE) {
+    this->device_allocator.destroy_buffer(buffer);
+  }
+
+  VkBufferCreateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = capacity;
+  buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // Read once by the GPU, directly from host memory
+  buffer = this->device_allocator.create_buffer(
+      buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  return true;
+}
+
+VkBuffer InstanceBuffer::get_buffer() const {
+  return this->buffers[this->region].buffer;
+}
+
+void *InstanceBuffer::get_mapped() const {
+  return this->buffers[this->region].allocation.mapped;
+}
+} // namespace instance
+} // namespace utils
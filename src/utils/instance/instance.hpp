@@ -0,0 +1,45 @@
+#ifndef INSTANCE_HPP
+#define INSTANCE_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <vector>
+
+#include "../memory/memory.hpp"
+
+namespace utils {
+namespace instance {
+/** Host visible vertex buffers of the instance attributes */
+// One buffer per region (frame context, or swap chain image when the
+// command buffers are cached), rewritten every frame and read once by the
+// GPU. A region only grows (to a power of two) when a frame needs more:
+// its buffer is recreated right away, since the frame that last read it is
+// finished.
+class InstanceBuffer {
+public:
+  InstanceBuffer(memory::DeviceAllocator &device_allocator,
+                 uint32_t region_count);
+  ~InstanceBuffer();
+
+  InstanceBuffer(const InstanceBuffer &) = delete;
+  InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+  // Write `region` with `size` bytes (the frame that last used it must be
+  // finished), returns true if its buffer was recreated (the command buffers
+  // binding the old one must be recorded again)
+  bool begin_region(uint32_t region, VkDeviceSize size);
+
+  // Of the current region (`VK_NULL_HANDLE`/`nullptr` before its first use)
+  VkBuffer get_buffer() const;
+  void *get_mapped() const;
+
+private:
+  memory::DeviceAllocator &device_allocator;
+  std::vector<memory::Buffer> buffers;
+  uint32_t region = 0;
+};
+} // namespace instance
+} // namespace utils
+
+#endif
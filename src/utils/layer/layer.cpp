@@ -1,25 +1,29 @@
 #include "layer.hpp"
 
+#include "../trace/trace.hpp"
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <cstdint>
-#include <set>
 #include <string>
 
-std::set<std::string> layers_available;
-
 namespace utils {
 namespace layer {
-void get_layers() {
+std::vector<std::string> get_layers() {
+  utils::trace::Scope scope("utils::layer::get_layers");
+
   uint32_t layerCount = 0;
   vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
 
   std::vector<VkLayerProperties> layers(layerCount);
   vkEnumerateInstanceLayerProperties(&layerCount, layers.data());
 
+  std::vector<std::string> layers_available;
   for (const auto &layer : layers) {
-    layers_available.insert(layer.layerName);
+    layers_available.push_back(layer.layerName);
   }
+
+  return layers_available;
 }
 std::vector<const char *> get_validation_layers() {
   std::vector<const char *> validation_layers = {"VK_LAYER_KHRONOS_validation"};
@@ -28,9 +32,10 @@ std::vector<const char *> get_validation_layers() {
 }
 
 bool check_validation_layers(
+    const capability::NameSet &layers_available,
     const std::vector<const char *> &validation_layers) {
   for (const auto &layer : validation_layers) {
-    if (layers_available.find(layer) == layers_available.end()) {
+    if (!layers_available.contains(layer)) {
       return false;
     }
   }
@@ -1,14 +1,19 @@
 #ifndef LAYER_HPP
 #define LAYER_HPP
 
+#include <string>
 #include <vector>
 
+#include "../capability/capability.hpp"
+
 namespace utils {
 namespace layer {
-void get_layers();
+// Enumerate (see `utils::capability::CapabilityCache` for the cached ones)
+std::vector<std::string> get_layers();
 std::vector<const char *> get_validation_layers();
 
 bool check_validation_layers(
+    const capability::NameSet &layers_available,
     const std::vector<const char *> &validation_layers);
 } // namespace layer
 } // namespace utils
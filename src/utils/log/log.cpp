@@ -0,0 +1,252 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace utils {
+namespace log {
+Severity parse_severity(const std::string &name) {
+  if (name == "verbose") {
+    return Severity::VERBOSE;
+  } else if (name == "info") {
+    return Severity::INFO;
+  } else if (name == "warning") {
+    return Severity::WARNING;
+  } else if (name == "error") {
+    return Severity::ERROR;
+  }
+
+  throw std::runtime_error("Unknown log severity: " + name);
+}
+
+std::string severity_name(Severity severity) {
+  switch (severity) {
+  case Severity::VERBOSE:
+    return "verbose";
+  case Severity::INFO:
+    return "info";
+  case Severity::WARNING:
+    return "warning";
+  case Severity::ERROR:
+    return "error";
+  }
+
+  return "";
+}
+
+// Time the drain thread sleeps when there is nothing to write
+static const std::chrono::milliseconds drain_interval(5);
+
+static void copy_truncated(char *destination, const char *source,
+                           size_t size) {
+  if (source == nullptr) {
+    destination[0] = '\0';
+    return;
+  }
+
+  size_t length = std::min(std::strlen(source), size - 1);
+  std::memcpy(destination, source, length);
+  destination[length] = '\0';
+}
+
+AsyncLogger::AsyncLogger(std::ostream &out, Severity min_severity,
+                         size_t capacity)
+    : out(out), min_severity(min_severity) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    throw std::runtime_error("log capacity must be a power of two");
+  }
+
+  this->slots = std::make_unique<Slot[]>(capacity);
+  this->mask = capacity - 1;
+  for (size_t i = 0; i < capacity; ++i) {
+    this->slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  this->id_counts = std::make_unique<IdCount[]>(id_table_size);
+
+  this->drain_thread = std::thread([this]() {
+    while (true) {
+      // Read before draining: nothing is pushed once it is set
+      bool stop = this->stopping.load(std::memory_order_acquire);
+
+      if (this->drain() == 0) {
+        if (stop) {
+          break;
+        }
+        std::this_thread::sleep_for(drain_interval);
+      }
+    }
+  });
+}
+
+AsyncLogger::~AsyncLogger() {
+  this->stopping.store(true, std::memory_order_release);
+  this->drain_thread.join();
+
+  this->write_summary();
+}
+
+void AsyncLogger::push(Severity severity, int32_t id, const char *name,
+                       const char *text) {
+  if (severity < this->min_severity.load(std::memory_order_relaxed)) {
+    this->filtered.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // Counted before claiming a slot, so that concurrent repeats are not all
+  // written (rolled back if the message is dropped)
+  IdCount *id_count = this->find_id(id);
+  if (id_count != nullptr &&
+      id_count->count.fetch_add(1, std::memory_order_relaxed) != 0) {
+    this->duplicates.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  /** Claim a slot */
+  size_t position = this->tail.load(std::memory_order_relaxed);
+  Slot *slot;
+  while (true) {
+    slot = &this->slots[position & this->mask];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t difference = static_cast<intptr_t>(sequence) -
+                          static_cast<intptr_t>(position);
+
+    if (difference == 0) {
+      if (this->tail.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // Not read yet by the drain thread: the ring is full. The next repeat
+      // of the ID is written instead (not a duplicate of a lost message).
+      if (id_count != nullptr) {
+        id_count->count.fetch_sub(1, std::memory_order_relaxed);
+      }
+      this->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      position = this->tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->severity = severity;
+  slot->id = id;
+  copy_truncated(slot->name, name, name_size);
+  copy_truncated(slot->text, text, text_size);
+
+  // Readable by the drain thread
+  slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void AsyncLogger::set_min_severity(Severity severity) {
+  this->min_severity.store(severity, std::memory_order_relaxed);
+}
+
+Severity AsyncLogger::get_min_severity() const {
+  return this->min_severity.load(std::memory_order_relaxed);
+}
+
+AsyncLogger::Counters AsyncLogger::get_counters() const {
+  Counters counters;
+  counters.written = this->written.load(std::memory_order_relaxed);
+  counters.duplicates = this->duplicates.load(std::memory_order_relaxed);
+  counters.filtered = this->filtered.load(std::memory_order_relaxed);
+  counters.dropped = this->dropped.load(std::memory_order_relaxed);
+
+  return counters;
+}
+
+AsyncLogger::IdCount *AsyncLogger::find_id(int32_t id) {
+  if (id == 0) {
+    return nullptr;
+  }
+
+  uint64_t key = static_cast<uint32_t>(id) | (1ull << 32);
+  size_t index = static_cast<uint32_t>(id) * 2654435761u % id_table_size;
+
+  // A few probes, a full neighbourhood writes the message every time
+  for (size_t probe = 0; probe < 16; ++probe) {
+    IdCount &entry = this->id_counts[(index + probe) % id_table_size];
+
+    uint64_t current = entry.key.load(std::memory_order_relaxed);
+    if (current == 0 &&
+        entry.key.compare_exchange_strong(current, key,
+                                          std::memory_order_relaxed)) {
+      current = key;
+    }
+
+    if (current == key) {
+      return &entry;
+    }
+  }
+
+  return nullptr;
+}
+
+size_t AsyncLogger::drain() {
+  size_t count = 0;
+
+  while (true) {
+    Slot &slot = this->slots[this->head & this->mask];
+    if (slot.sequence.load(std::memory_order_acquire) != this->head + 1) {
+      break;
+    }
+
+    this->out << "[" << severity_name(slot.severity) << "] " << slot.name
+              << ": " << slot.text << '\n';
+
+    if (slot.id != 0) {
+      this->id_names.emplace(slot.id, slot.name);
+    }
+
+    // Free for the producers (one lap later)
+    slot.sequence.store(this->head + this->mask + 1,
+                        std::memory_order_release);
+    ++this->head;
+    ++count;
+  }
+
+  // One flush per batch instead of one per message
+  if (count > 0) {
+    this->written.fetch_add(count, std::memory_order_relaxed);
+    this->out.flush();
+  }
+
+  return count;
+}
+
+void AsyncLogger::write_summary() {
+  Counters counters = this->get_counters();
+  if (counters.written + counters.duplicates + counters.dropped == 0) {
+    return;
+  }
+
+  this->out << "Debug messages: " << counters.written << " written, "
+            << counters.duplicates << " duplicates, " << counters.filtered
+            << " filtered, " << counters.dropped << " dropped" << '\n';
+
+  // Most repeated IDs
+  std::vector<std::pair<uint64_t, int32_t>> repeated;
+  for (size_t i = 0; i < id_table_size; ++i) {
+    uint64_t key = this->id_counts[i].key.load(std::memory_order_relaxed);
+    uint64_t count = this->id_counts[i].count.load(std::memory_order_relaxed);
+
+    if (key != 0 && count > 1) {
+      repeated.emplace_back(count, static_cast<int32_t>(key & 0xffffffff));
+    }
+  }
+
+  std::sort(repeated.rbegin(), repeated.rend());
+  repeated.resize(std::min<size_t>(repeated.size(), 10));
+
+  for (const auto &[count, id] : repeated) {
+    this->out << "  " << count << "x " << this->id_names[id] << '\n';
+  }
+
+  this->out.flush();
+}
+} // namespace log
+} // namespace utils
@@ -0,0 +1,109 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace utils {
+namespace log {
+enum class Severity : uint32_t { VERBOSE, INFO, WARNING, ERROR };
+
+// "verbose", "info", "warning" or "error"
+Severity parse_severity(const std::string &name);
+std::string severity_name(Severity severity);
+
+/** Messages written by a background thread, pushed without locks */
+// Made for the validation layer callback: `push()` never blocks the driver
+// thread (a full ring drops the message), a message ID is only written the
+// first time (the repeats are counted) and the messages below the minimum
+// severity are rejected before being copied.
+class AsyncLogger {
+public:
+  // `capacity` (power of two) messages can wait to be written
+  AsyncLogger(std::ostream &out, Severity min_severity,
+              size_t capacity = 1024);
+  // Write the waiting messages and the counters
+  ~AsyncLogger();
+
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+  // Thread-safe and lock-free. `id` 0 is never deduplicated (no ID), `name`
+  // and `text` are copied (truncated if too long).
+  void push(Severity severity, int32_t id, const char *name, const char *text);
+
+  void set_min_severity(Severity severity);
+  Severity get_min_severity() const;
+
+  struct Counters {
+    uint64_t written = 0;
+    // Repeats of an already written message ID
+    uint64_t duplicates = 0;
+    // Below the minimum severity
+    uint64_t filtered = 0;
+    // The ring was full
+    uint64_t dropped = 0;
+  };
+  Counters get_counters() const;
+
+private:
+  static const size_t name_size = 64;
+  static const size_t text_size = 1024;
+  static const size_t id_table_size = 1024;
+
+  /** Ring slot, `sequence` tells who owns it (bounded MPMC queue) */
+  struct Slot {
+    std::atomic<size_t> sequence;
+    Severity severity;
+    int32_t id;
+    char name[name_size];
+    char text[text_size];
+  };
+
+  /** Times a message ID was pushed (open addressing, never removed) */
+  struct IdCount {
+    // ID + 1 << 32 (0 = free)
+    std::atomic<uint64_t> key{0};
+    std::atomic<uint64_t> count{0};
+  };
+
+  std::ostream &out;
+  std::atomic<Severity> min_severity;
+
+  std::unique_ptr<Slot[]> slots;
+  size_t mask;
+  // Next slot written by the producers
+  alignas(64) std::atomic<size_t> tail{0};
+  // Next slot read by the drain thread (only used by it)
+  alignas(64) size_t head = 0;
+
+  std::unique_ptr<IdCount[]> id_counts;
+
+  std::atomic<uint64_t> written{0};
+  std::atomic<uint64_t> duplicates{0};
+  std::atomic<uint64_t> filtered{0};
+  std::atomic<uint64_t> dropped{0};
+
+  // Name of the written IDs (only used by the drain thread)
+  std::unordered_map<int32_t, std::string> id_names;
+
+  std::atomic<bool> stopping{false};
+  std::thread drain_thread;
+
+  // Entry counting the pushes of `id` (inserted if new), `nullptr` if it is
+  // not deduplicated (ID 0 or full neighbourhood)
+  IdCount *find_id(int32_t id);
+  // Write the waiting messages, returns how many
+  size_t drain();
+  void write_summary();
+};
+} // namespace log
+} // namespace utils
+
+#endif
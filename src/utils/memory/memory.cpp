@@ -0,0 +1,589 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace utils {
+namespace memory {
+// Smallest range of a block (order 0)
+static const VkDeviceSize min_range_size = 256;
+// Heaps smaller than that get smaller blocks (e.g. the host visible device
+// local heap of 256 MiB)
+static const VkDeviceSize small_heap_size = 1024ull * 1024 * 1024;
+
+uint32_t
+find_memory_type(const VkPhysicalDeviceMemoryProperties &memory_properties,
+                 uint32_t type_filter, VkMemoryPropertyFlags properties) {
+  // `type_filter` is a bit field of the memory types that are suitable for the
+  // resource (`VkMemoryRequirements::memoryTypeBits`), and from those we need
+  // one that has all the requested properties.
+  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+    if ((type_filter & (1 << i)) &&
+        (memory_properties.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+// Largest power of two <= `size` (`size` > 0)
+static VkDeviceSize floor_power_of_two(VkDeviceSize size) {
+  VkDeviceSize power = 1;
+  while (power <= size / 2) {
+    power <<= 1;
+  }
+
+  return power;
+}
+
+// Order of the smallest range holding `size` bytes aligned on `alignment`
+static uint32_t get_order(VkDeviceSize size, VkDeviceSize alignment) {
+  VkDeviceSize needed = std::max(size, alignment);
+
+  uint32_t order = 0;
+  while ((min_range_size << order) < needed) {
+    ++order;
+  }
+
+  return order;
+}
+
+DeviceAllocator::DeviceAllocator(
+    VkDevice device, const VkPhysicalDeviceMemoryProperties &memory_properties,
+    const VkPhysicalDeviceLimits &limits,
+    const VkAllocationCallbacks *allocator, VkDeviceSize block_size)
+    : device(device), memory_properties(memory_properties),
+      allocator(allocator),
+      max_memory_allocation_count(limits.maxMemoryAllocationCount),
+      pools(memory_properties.memoryTypeCount * 2) {
+  block_size = floor_power_of_two(std::max(block_size, min_range_size));
+
+  for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+    VkDeviceSize heap_size = memory_properties.memoryHeaps[i].size;
+    VkDeviceSize heap_block_size = block_size;
+
+    // A few blocks must fit in the heap
+    if (heap_size < small_heap_size) {
+      heap_block_size = std::min(
+          heap_block_size,
+          floor_power_of_two(std::max(heap_size / 8, min_range_size)));
+    }
+
+    this->block_sizes.push_back(heap_block_size);
+  }
+}
+
+DeviceAllocator::~DeviceAllocator() {
+  for (auto &record : this->records) {
+    if (record.second.block == nullptr) {
+      this->free_memory(record.second.allocation.memory,
+                        record.second.allocation.mapped);
+    }
+  }
+
+  for (auto &pool : this->pools) {
+    for (auto &block : pool.blocks) {
+      this->free_memory(block->memory, block->mapped);
+    }
+  }
+}
+
+Allocation DeviceAllocator::allocate(const VkMemoryRequirements &requirements,
+                                     VkMemoryPropertyFlags properties,
+                                     bool linear, bool dedicated) {
+  uint32_t memory_type = find_memory_type(
+      this->memory_properties, requirements.memoryTypeBits, properties);
+  uint32_t pool_index = memory_type * 2 + (linear ? 0 : 1);
+  uint32_t order = get_order(requirements.size, requirements.alignment);
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  // Half a block would waste the other half
+  VkDeviceSize block_size = this->block_sizes[this->get_heap(pool_index)];
+  if (dedicated || (min_range_size << order) > block_size / 2) {
+    Record record;
+    record.pool = pool_index;
+    record.allocation.size = requirements.size;
+    record.allocation.memory_type = memory_type;
+    record.allocation.memory = this->allocate_memory(
+        memory_type, requirements.size, &record.allocation.mapped);
+    if (record.allocation.memory == VK_NULL_HANDLE) {
+      throw std::runtime_error("failed to allocate device memory!");
+    }
+
+    record.allocation.id = this->next_id++;
+    this->records[record.allocation.id] = record;
+
+    return record.allocation;
+  }
+
+  return this->allocate_in_pool(pool_index, requirements.size, order, true);
+}
+
+void DeviceAllocator::free(const Allocation &allocation) {
+  if (allocation.id == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->free_locked(allocation.id);
+}
+
+Buffer DeviceAllocator::create_buffer(const VkBufferCreateInfo &create_info,
+                                      VkMemoryPropertyFlags properties) {
+  Buffer buffer;
+  if (vkCreateBuffer(this->device, &create_info, this->allocator,
+                     &buffer.buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create buffer!");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(this->device, buffer.buffer, &requirements);
+
+  try {
+    buffer.allocation = this->allocate(requirements, properties, true);
+  } catch (...) {
+    vkDestroyBuffer(this->device, buffer.buffer, this->allocator);
+    throw;
+  }
+
+  if (vkBindBufferMemory(this->device, buffer.buffer, buffer.allocation.memory,
+                         buffer.allocation.offset) != VK_SUCCESS) {
+    this->destroy_buffer(buffer);
+    throw std::runtime_error("failed to bind buffer memory!");
+  }
+
+  return buffer;
+}
+
+void DeviceAllocator::destroy_buffer(const Buffer &buffer) {
+  vkDestroyBuffer(this->device, buffer.buffer, this->allocator);
+  this->free(buffer.allocation);
+}
+
+Image DeviceAllocator::create_image(const VkImageCreateInfo &create_info,
+                                    VkMemoryPropertyFlags properties,
+                                    bool dedicated) {
+  Image image;
+  if (vkCreateImage(this->device, &create_info, this->allocator,
+                    &image.image) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create image!");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(this->device, image.image, &requirements);
+
+  try {
+    image.allocation = this->allocate(
+        requirements, properties,
+        create_info.tiling == VK_IMAGE_TILING_LINEAR, dedicated);
+  } catch (...) {
+    vkDestroyImage(this->device, image.image, this->allocator);
+    throw;
+  }
+
+  if (vkBindImageMemory(this->device, image.image, image.allocation.memory,
+                        image.allocation.offset) != VK_SUCCESS) {
+    this->destroy_image(image);
+    throw std::runtime_error("failed to bind image memory!");
+  }
+
+  return image;
+}
+
+void DeviceAllocator::destroy_image(const Image &image) {
+  vkDestroyImage(this->device, image.image, this->allocator);
+  this->free(image.allocation);
+}
+
+std::vector<DefragmentationMove>
+DeviceAllocator::begin_defragmentation(VkDeviceSize max_bytes) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  std::vector<DefragmentationMove> moves;
+  VkDeviceSize moved_bytes = 0;
+
+  for (uint32_t i = 0; i < this->pools.size(); ++i) {
+    Pool &pool = this->pools[i];
+    if (pool.blocks.size() < 2) {
+      continue;
+    }
+
+    // The least used block that isn't empty (nor already being emptied)
+    Block *source = nullptr;
+    for (auto &block : pool.blocks) {
+      if (!block->allocations.empty() && !block->defragmenting &&
+          (source == nullptr ||
+           block->reserved_bytes < source->reserved_bytes)) {
+        source = block.get();
+      }
+    }
+
+    if (source == nullptr ||
+        moved_bytes + source->reserved_bytes > max_bytes) {
+      continue;
+    }
+
+    // Nothing else is allocated in the source from now on
+    source->defragmenting = true;
+
+    std::vector<DefragmentationMove> pool_moves;
+    for (uint64_t id : source->allocations) {
+      const Record &record = this->records[id];
+
+      DefragmentationMove move;
+      move.source = record.allocation;
+      move.destination = this->allocate_in_pool(i, record.allocation.size,
+                                                record.order, false);
+      if (move.destination.id == 0) {
+        break;
+      }
+
+      pool_moves.push_back(move);
+    }
+
+    // Moving part of the allocations would not free the block
+    if (pool_moves.size() != source->allocations.size()) {
+      for (const auto &move : pool_moves) {
+        this->free_locked(move.destination.id);
+      }
+      source->defragmenting = false;
+
+      continue;
+    }
+
+    moved_bytes += source->reserved_bytes;
+    moves.insert(moves.end(), pool_moves.begin(), pool_moves.end());
+  }
+
+  return moves;
+}
+
+void DeviceAllocator::end_defragmentation(
+    const std::vector<DefragmentationMove> &moves) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  // The resources of a source may already be destroyed (no record left)
+  for (const auto &move : moves) {
+    if (this->records.count(move.source.id) != 0) {
+      this->free_locked(move.source.id);
+    }
+  }
+
+  // Every source block is usable again, then freed if left empty. Found by
+  // their memory, since the records of the sources may be gone.
+  for (const auto &move : moves) {
+    uint32_t linear_pool = move.source.memory_type * 2;
+    for (uint32_t pool_index = linear_pool; pool_index < linear_pool + 2;
+         ++pool_index) {
+      auto &blocks = this->pools[pool_index].blocks;
+      auto block = std::find_if(
+          blocks.begin(), blocks.end(), [&move](const auto &other) {
+            return other->memory == move.source.memory;
+          });
+
+      if (block != blocks.end() && (*block)->defragmenting) {
+        (*block)->defragmenting = false;
+        this->release_block(pool_index, block->get());
+      }
+    }
+  }
+}
+
+DeviceMemoryStatistics DeviceAllocator::get_statistics(uint32_t heap) const {
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  DeviceMemoryStatistics statistics;
+
+  for (uint32_t i = 0; i < this->pools.size(); ++i) {
+    if (this->get_heap(i) != heap) {
+      continue;
+    }
+
+    for (const auto &block : this->pools[i].blocks) {
+      ++statistics.memory_allocations;
+      ++statistics.blocks;
+      statistics.block_bytes += block->size;
+      statistics.reserved_bytes += block->reserved_bytes;
+
+      for (uint32_t order = block->max_order + 1; order > 0; --order) {
+        if (!block->free_ranges[order - 1].empty()) {
+          statistics.largest_free_range =
+              std::max<uint64_t>(statistics.largest_free_range,
+                                 min_range_size << (order - 1));
+          break;
+        }
+      }
+    }
+  }
+
+  for (const auto &record : this->records) {
+    if (this->get_heap(record.second.pool) != heap) {
+      continue;
+    }
+
+    if (record.second.block == nullptr) {
+      ++statistics.memory_allocations;
+      ++statistics.dedicated_allocations;
+      statistics.dedicated_bytes += record.second.allocation.size;
+    } else {
+      ++statistics.allocations;
+      statistics.used_bytes += record.second.allocation.size;
+    }
+  }
+
+  return statistics;
+}
+
+DeviceMemoryStatistics DeviceAllocator::get_total_statistics() const {
+  DeviceMemoryStatistics total;
+
+  for (uint32_t i = 0; i < this->memory_properties.memoryHeapCount; ++i) {
+    DeviceMemoryStatistics statistics = this->get_statistics(i);
+    total.memory_allocations += statistics.memory_allocations;
+    total.blocks += statistics.blocks;
+    total.block_bytes += statistics.block_bytes;
+    total.allocations += statistics.allocations;
+    total.used_bytes += statistics.used_bytes;
+    total.reserved_bytes += statistics.reserved_bytes;
+    total.largest_free_range =
+        std::max(total.largest_free_range, statistics.largest_free_range);
+    total.dedicated_allocations += statistics.dedicated_allocations;
+    total.dedicated_bytes += statistics.dedicated_bytes;
+  }
+
+  return total;
+}
+
+void DeviceAllocator::print_statistics(std::ostream &out) const {
+  for (uint32_t i = 0; i < this->memory_properties.memoryHeapCount; ++i) {
+    DeviceMemoryStatistics statistics = this->get_statistics(i);
+    if (statistics.memory_allocations == 0) {
+      continue;
+    }
+
+    out << "Device memory (heap " << i << "): " << statistics.blocks
+        << " blocks of " << statistics.block_bytes << " bytes, "
+        << statistics.allocations << " allocations using "
+        << statistics.used_bytes << " bytes (" << statistics.reserved_bytes
+        << " reserved), " << statistics.dedicated_allocations
+        << " dedicated allocations of " << statistics.dedicated_bytes
+        << " bytes" << std::endl;
+  }
+}
+
+VkDeviceMemory DeviceAllocator::allocate_memory(uint32_t memory_type,
+                                                VkDeviceSize size,
+                                                void **mapped) {
+  // Some drivers only allow 4096 allocations
+  if (this->memory_allocation_count >= this->max_memory_allocation_count) {
+    throw std::runtime_error("maxMemoryAllocationCount reached!");
+  }
+
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type;
+
+  // Out of memory is not an error here, a smaller block may still fit
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(this->device, &alloc_info, this->allocator, &memory) !=
+      VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  ++this->memory_allocation_count;
+
+  *mapped = nullptr;
+  if ((this->memory_properties.memoryTypes[memory_type].propertyFlags &
+       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      vkMapMemory(this->device, memory, 0, VK_WHOLE_SIZE, 0, mapped) !=
+          VK_SUCCESS) {
+    this->free_memory(memory, nullptr);
+    throw std::runtime_error("failed to map device memory!");
+  }
+
+  return memory;
+}
+
+void DeviceAllocator::free_memory(VkDeviceMemory memory, void *mapped) {
+  if (mapped != nullptr) {
+    vkUnmapMemory(this->device, memory);
+  }
+
+  vkFreeMemory(this->device, memory, this->allocator);
+  --this->memory_allocation_count;
+}
+
+DeviceAllocator::Block *
+DeviceAllocator::find_block(Pool &pool, uint32_t order, bool use_empty) {
+  // The most used block that fits, so that the others can become empty
+  Block *best = nullptr;
+
+  for (auto &block : pool.blocks) {
+    if (block->defragmenting || order > block->max_order ||
+        (!use_empty && block->allocations.empty()) ||
+        (best != nullptr && block->reserved_bytes <= best->reserved_bytes)) {
+      continue;
+    }
+
+    for (uint32_t i = order; i <= block->max_order; ++i) {
+      if (!block->free_ranges[i].empty()) {
+        best = block.get();
+        break;
+      }
+    }
+  }
+
+  return best;
+}
+
+DeviceAllocator::Block *DeviceAllocator::create_block(uint32_t pool_index,
+                                                      uint32_t order) {
+  uint32_t memory_type = pool_index / 2;
+  VkDeviceSize size = this->block_sizes[this->get_heap(pool_index)];
+
+  // Smaller blocks when the heap is almost full
+  auto block = std::make_unique<Block>();
+  for (; size >= (min_range_size << order); size /= 2) {
+    block->memory = this->allocate_memory(memory_type, size, &block->mapped);
+    if (block->memory != VK_NULL_HANDLE) {
+      break;
+    }
+  }
+
+  if (block->memory == VK_NULL_HANDLE) {
+    throw std::runtime_error("failed to allocate device memory!");
+  }
+
+  block->size = size;
+  block->max_order = get_order(size, 1);
+  block->free_ranges.resize(block->max_order + 1);
+  block->free_ranges[block->max_order].insert(0);
+
+  this->pools[pool_index].blocks.push_back(std::move(block));
+
+  return this->pools[pool_index].blocks.back().get();
+}
+
+VkDeviceSize DeviceAllocator::allocate_range(Block &block, uint32_t order) {
+  // Smallest free range that is big enough
+  uint32_t i = order;
+  while (block.free_ranges[i].empty()) {
+    ++i;
+  }
+
+  VkDeviceSize offset = *block.free_ranges[i].begin();
+  block.free_ranges[i].erase(block.free_ranges[i].begin());
+
+  // Split it in halves, the second half of each split stays free
+  while (i > order) {
+    --i;
+    block.free_ranges[i].insert(offset + (min_range_size << i));
+  }
+
+  block.reserved_bytes += min_range_size << order;
+
+  return offset;
+}
+
+void DeviceAllocator::free_range(Block &block, VkDeviceSize offset,
+                                 uint32_t order) {
+  block.reserved_bytes -= min_range_size << order;
+
+  // Merge with the buddy (the other half of the parent range) while free
+  while (order < block.max_order) {
+    VkDeviceSize buddy = offset ^ (min_range_size << order);
+
+    auto it = block.free_ranges[order].find(buddy);
+    if (it == block.free_ranges[order].end()) {
+      break;
+    }
+
+    block.free_ranges[order].erase(it);
+    offset = std::min(offset, buddy);
+    ++order;
+  }
+
+  block.free_ranges[order].insert(offset);
+}
+
+Allocation DeviceAllocator::allocate_in_pool(uint32_t pool_index,
+                                             VkDeviceSize size, uint32_t order,
+                                             bool create) {
+  Block *block = this->find_block(this->pools[pool_index], order, create);
+  if (block == nullptr) {
+    if (!create) {
+      return Allocation{};
+    }
+
+    block = this->create_block(pool_index, order);
+  }
+
+  Record record;
+  record.pool = pool_index;
+  record.block = block;
+  record.order = order;
+  record.allocation.memory = block->memory;
+  record.allocation.offset = this->allocate_range(*block, order);
+  record.allocation.size = size;
+  record.allocation.memory_type = pool_index / 2;
+  if (block->mapped != nullptr) {
+    record.allocation.mapped =
+        static_cast<char *>(block->mapped) + record.allocation.offset;
+  }
+
+  record.allocation.id = this->next_id++;
+  block->allocations.insert(record.allocation.id);
+  this->records[record.allocation.id] = record;
+
+  return record.allocation;
+}
+
+void DeviceAllocator::free_locked(uint64_t id) {
+  auto it = this->records.find(id);
+  if (it == this->records.end()) {
+    throw std::runtime_error("device memory freed twice!");
+  }
+
+  Record record = it->second;
+  this->records.erase(it);
+
+  if (record.block == nullptr) {
+    this->free_memory(record.allocation.memory, record.allocation.mapped);
+    return;
+  }
+
+  this->free_range(*record.block, record.allocation.offset, record.order);
+  record.block->allocations.erase(id);
+  this->release_block(record.pool, record.block);
+}
+
+void DeviceAllocator::release_block(uint32_t pool_index, Block *block) {
+  if (!block->allocations.empty() || block->defragmenting) {
+    return;
+  }
+
+  // One empty block is kept, so that an allocation freed and allocated again
+  // each frame doesn't allocate a block each time
+  auto &blocks = this->pools[pool_index].blocks;
+  bool other_empty_block =
+      std::any_of(blocks.begin(), blocks.end(), [block](const auto &other) {
+        return other.get() != block && other->allocations.empty();
+      });
+  if (!other_empty_block) {
+    return;
+  }
+
+  this->free_memory(block->memory, block->mapped);
+  blocks.erase(std::find_if(
+      blocks.begin(), blocks.end(),
+      [block](const auto &other) { return other.get() == block; }));
+}
+
+uint32_t DeviceAllocator::get_heap(uint32_t pool_index) const {
+  return this->memory_properties.memoryTypes[pool_index / 2].heapIndex;
+}
+} // namespace memory
+} // namespace utils
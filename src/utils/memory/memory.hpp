@@ -0,0 +1,186 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace utils {
+namespace memory {
+uint32_t
+find_memory_type(const VkPhysicalDeviceMemoryProperties &memory_properties,
+                 uint32_t type_filter, VkMemoryPropertyFlags properties);
+
+/** Range of device memory bound to a buffer or an image */
+struct Allocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // Persistently mapped (`nullptr` if the memory is not host visible)
+  void *mapped = nullptr;
+  uint32_t memory_type = 0;
+  // Identifies the allocation in the allocator (0 = no allocation)
+  uint64_t id = 0;
+};
+
+struct Buffer {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  Allocation allocation;
+};
+
+struct Image {
+  VkImage image = VK_NULL_HANDLE;
+  Allocation allocation;
+};
+
+/** Allocation to copy during a defragmentation */
+// The contents of `source` must be copied to `destination` and the resource
+// bound to `destination` (recreated) before `end_defragmentation()`
+struct DefragmentationMove {
+  Allocation source;
+  Allocation destination;
+};
+
+/** Device memory of one heap (or of every heap) */
+struct DeviceMemoryStatistics {
+  // `vkAllocateMemory` calls (blocks + dedicated allocations)
+  uint64_t memory_allocations = 0;
+  uint64_t blocks = 0;
+  uint64_t block_bytes = 0;
+  // Allocations inside the blocks, requested and rounded up to the buddy
+  // sizes (the difference is the internal fragmentation)
+  uint64_t allocations = 0;
+  uint64_t used_bytes = 0;
+  uint64_t reserved_bytes = 0;
+  // Biggest range still free in a block
+  uint64_t largest_free_range = 0;
+  uint64_t dedicated_allocations = 0;
+  uint64_t dedicated_bytes = 0;
+};
+
+/** Suballocates the buffers and images from large device memory blocks */
+// The blocks are kept per memory type and per tiling (linear resources and
+// optimal images never share a block, so `bufferImageGranularity` can be
+// ignored), and split with a buddy allocator: a range is a power of two
+// aligned on its size, freed ranges merge back with their buddy. The ranges
+// bigger than half a block get their own `vkAllocateMemory` (dedicated).
+// Host visible memory stays mapped. Thread-safe (one lock).
+class DeviceAllocator {
+public:
+  // `block_size` is rounded down to a power of two (smaller on small heaps)
+  DeviceAllocator(VkDevice device,
+                  const VkPhysicalDeviceMemoryProperties &memory_properties,
+                  const VkPhysicalDeviceLimits &limits,
+                  const VkAllocationCallbacks *allocator,
+                  VkDeviceSize block_size = 64 * 1024 * 1024);
+  // The memory is freed: the resources must be destroyed before
+  ~DeviceAllocator();
+
+  DeviceAllocator(const DeviceAllocator &) = delete;
+  DeviceAllocator &operator=(const DeviceAllocator &) = delete;
+
+  // `linear` for buffers and linear images, false for optimal images
+  Allocation allocate(const VkMemoryRequirements &requirements,
+                      VkMemoryPropertyFlags properties, bool linear,
+                      bool dedicated = false);
+  void free(const Allocation &allocation);
+
+  // Create the resource and bind it to new memory with `properties`
+  Buffer create_buffer(const VkBufferCreateInfo &create_info,
+                       VkMemoryPropertyFlags properties);
+  void destroy_buffer(const Buffer &buffer);
+  Image create_image(const VkImageCreateInfo &create_info,
+                     VkMemoryPropertyFlags properties, bool dedicated = false);
+  void destroy_image(const Image &image);
+
+  /** Defragmentation hooks */
+  // Move the allocations of the least used blocks into the other blocks (at
+  // most `max_bytes`), a block is only emptied if all of its allocations fit
+  // elsewhere. The sources stay allocated until `end_defragmentation()`, to
+  // be called once the GPU is done copying them.
+  std::vector<DefragmentationMove>
+  begin_defragmentation(VkDeviceSize max_bytes);
+  // Free the sources (and the blocks left empty)
+  void end_defragmentation(const std::vector<DefragmentationMove> &moves);
+
+  DeviceMemoryStatistics get_statistics(uint32_t heap) const;
+  DeviceMemoryStatistics get_total_statistics() const;
+  // One line per heap that has memory allocated
+  void print_statistics(std::ostream &out) const;
+
+private:
+  /** `vkAllocateMemory` split by the buddy allocator */
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;
+    // Order of the whole block (ranges of `min_range_size << order`)
+    uint32_t max_order = 0;
+    // Offsets of the free ranges of each order
+    std::vector<std::set<VkDeviceSize>> free_ranges;
+    // Live allocations (`id`s) of the block
+    std::set<uint64_t> allocations;
+    VkDeviceSize reserved_bytes = 0;
+    // Being emptied by a defragmentation (nothing new is allocated in it)
+    bool defragmenting = false;
+  };
+
+  /** Blocks of one memory type and tiling */
+  struct Pool {
+    std::vector<std::unique_ptr<Block>> blocks;
+  };
+
+  /** Where a live allocation comes from */
+  struct Record {
+    Allocation allocation;
+    // Index in `pools`, `nullptr` block for a dedicated allocation
+    uint32_t pool = 0;
+    Block *block = nullptr;
+    uint32_t order = 0;
+  };
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memory_properties;
+  const VkAllocationCallbacks *allocator;
+  uint32_t max_memory_allocation_count;
+  // Block size of each heap
+  std::vector<VkDeviceSize> block_sizes;
+
+  mutable std::mutex mutex;
+  // Two pools per memory type (linear, optimal)
+  std::vector<Pool> pools;
+  std::unordered_map<uint64_t, Record> records;
+  uint64_t next_id = 1;
+  uint32_t memory_allocation_count = 0;
+
+  VkDeviceMemory allocate_memory(uint32_t memory_type, VkDeviceSize size,
+                                 void **mapped);
+  void free_memory(VkDeviceMemory memory, void *mapped);
+
+  // `nullptr` if no block of the pool has a free range of `order` (nor, if
+  // `use_empty` is false, any allocation)
+  Block *find_block(Pool &pool, uint32_t order, bool use_empty);
+  Block *create_block(uint32_t pool_index, uint32_t order);
+  VkDeviceSize allocate_range(Block &block, uint32_t order);
+  void free_range(Block &block, VkDeviceSize offset, uint32_t order);
+
+  // Without `create`, only in the blocks in use (an empty allocation, `id` 0,
+  // if they have no room)
+  Allocation allocate_in_pool(uint32_t pool_index, VkDeviceSize size,
+                              uint32_t order, bool create);
+  void free_locked(uint64_t id);
+  // Free `block` if empty and its pool has another empty block
+  void release_block(uint32_t pool_index, Block *block);
+
+  uint32_t get_heap(uint32_t pool_index) const;
+};
+} // namespace memory
+} // namespace utils
+
+#endif
@@ -0,0 +1,76 @@
+#include "mesh.hpp"
+
+#include <stdexcept>
+
+namespace utils {
+namespace mesh {
+// Device local buffer written by the copies of the staging ring
+static memory::Buffer create_device_buffer(
+    memory::DeviceAllocator &device_allocator, VkDeviceSize size,
+    VkBufferUsageFlags usage) {
+  VkBufferCreateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = size;
+  buffer_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  return device_allocator.create_buffer(buffer_info,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+Mesh create_mesh(memory::DeviceAllocator &device_allocator,
+                 staging::StagingRing &staging_ring, const void *vertices,
+                 uint32_t vertex_count, uint32_t vertex_stride,
+                 const std::vector<uint32_t> &indices) {
+  if (vertex_count == 0 || vertex_stride == 0 || indices.empty()) {
+    throw std::runtime_error("a mesh needs vertices and indices!");
+  }
+
+  Mesh mesh;
+  mesh.vertex_count = vertex_count;
+  mesh.index_count = static_cast<uint32_t>(indices.size());
+
+  /** Vertices */
+  VkDeviceSize vertices_size =
+      static_cast<VkDeviceSize>(vertex_count) * vertex_stride;
+  mesh.vertex_buffer = create_device_buffer(
+      device_allocator, vertices_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  mesh.upload_batch = staging_ring.upload(mesh.vertex_buffer.buffer, 0,
+                                          vertices, vertices_size);
+
+  /** Indices */
+  if (vertex_count <= 0x10000) {
+    mesh.index_type = VK_INDEX_TYPE_UINT16;
+
+    std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+    VkDeviceSize indices_size = short_indices.size() * sizeof(uint16_t);
+    mesh.index_buffer = create_device_buffer(
+        device_allocator, indices_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    mesh.upload_batch = staging_ring.upload(
+        mesh.index_buffer.buffer, 0, short_indices.data(), indices_size);
+  } else {
+    VkDeviceSize indices_size = indices.size() * sizeof(uint32_t);
+    mesh.index_buffer = create_device_buffer(
+        device_allocator, indices_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    mesh.upload_batch = staging_ring.upload(mesh.index_buffer.buffer, 0,
+                                            indices.data(), indices_size);
+  }
+
+  return mesh;
+}
+
+void destroy_mesh(memory::DeviceAllocator &device_allocator,
+                  const Mesh &mesh) {
+  device_allocator.destroy_buffer(mesh.vertex_buffer);
+  device_allocator.destroy_buffer(mesh.index_buffer);
+}
+
+void bind_mesh(VkCommandBuffer command_buffer, const Mesh &mesh) {
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh.vertex_buffer.buffer,
+                         &offset);
+  vkCmdBindIndexBuffer(command_buffer, mesh.index_buffer.buffer, 0,
+                       mesh.index_type);
+}
+} // namespace mesh
+} // namespace utils
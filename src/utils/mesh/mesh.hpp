@@ -0,0 +1,41 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <vector>
+
+#include "../memory/memory.hpp"
+#include "../staging/staging.hpp"
+
+namespace utils {
+namespace mesh {
+/** Vertex and index buffers of a mesh (device local) */
+struct Mesh {
+  memory::Buffer vertex_buffer;
+  memory::Buffer index_buffer;
+  uint32_t vertex_count = 0;
+  uint32_t index_count = 0;
+  // 16 bits when every vertex can be indexed with them (half the bandwidth)
+  VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+  // Staging batch of the upload: drawable once the ring has it ready
+  uint64_t upload_batch = 0;
+};
+
+// Create the buffers and record their upload in `staging_ring` (drawn once
+// `upload_batch` is ready). `vertices` has `vertex_count` vertices of
+// `vertex_stride` bytes.
+Mesh create_mesh(memory::DeviceAllocator &device_allocator,
+                 staging::StagingRing &staging_ring, const void *vertices,
+                 uint32_t vertex_count, uint32_t vertex_stride,
+                 const std::vector<uint32_t> &indices);
+// The GPU must be done with the mesh
+void destroy_mesh(memory::DeviceAllocator &device_allocator, const Mesh &mesh);
+
+// Bind the vertex buffer (binding 0) and the index buffer
+void bind_mesh(VkCommandBuffer command_buffer, const Mesh &mesh);
+} // namespace mesh
+} // namespace utils
+
+#endif
@@ -1,4 +1,7 @@
 #include "messenger.hpp"
+
+#include "../log/log.hpp"
+
 #include <iostream>
 
 namespace utils {
@@ -26,11 +29,34 @@ void destroy_debug_utils_messenger_ext(
   }
 }
 
+static utils::log::Severity
+to_severity(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity) {
+  if (message_severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+    return utils::log::Severity::ERROR;
+  } else if (message_severity &
+             VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+    return utils::log::Severity::WARNING;
+  } else if (message_severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+    return utils::log::Severity::INFO;
+  }
+
+  return utils::log::Severity::VERBOSE;
+}
+
 VKAPI_ATTR VkBool32 VKAPI_CALL
 debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-              VkDebugUtilsMessageTypeFlagsEXT messageType,
+              VkDebugUtilsMessageTypeFlagsEXT /* messageType */,
               const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
               void *pUserData) {
+  // Called by the driver threads: only a copy into the logger ring
+  if (pUserData != nullptr) {
+    static_cast<utils::log::AsyncLogger *>(pUserData)->push(
+        to_severity(messageSeverity), pCallbackData->messageIdNumber,
+        pCallbackData->pMessageIdName, pCallbackData->pMessage);
+
+    return VK_FALSE;
+  }
+
   std::cerr << "Message severity: " << messageSeverity << std::endl;
   std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
 
@@ -0,0 +1,475 @@
+#include "pipeline.hpp"
+
+#include "../shader/shader.hpp"
+#include "../trace/trace.hpp"
+
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+namespace utils {
+namespace pipeline {
+std::vector<VkVertexInputBindingDescription>
+get_binding_descriptions(const VertexFormat &format) {
+  std::vector<VkVertexInputBindingDescription> bindings;
+
+  // One vertex per vertex (not per instance)
+  if (format.stride != 0) {
+    VkVertexInputBindingDescription binding{};
+    binding.binding = 0;
+    binding.stride = format.stride;
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindings.push_back(binding);
+  }
+
+  // One element per instance, the same for all its vertices
+  if (format.instance_stride != 0) {
+    VkVertexInputBindingDescription binding{};
+    binding.binding = 1;
+    binding.stride = format.instance_stride;
+    binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    bindings.push_back(binding);
+  }
+
+  return bindings;
+}
+
+std::vector<VkVertexInputAttributeDescription>
+get_attribute_descriptions(const VertexFormat &format) {
+  std::vector<VkVertexInputAttributeDescription> descriptions;
+
+  auto add_attributes = [&descriptions](
+                            uint32_t binding,
+                            const std::vector<VertexAttribute> &attributes) {
+    for (const auto &attribute : attributes) {
+      VkVertexInputAttributeDescription description{};
+      description.binding = binding;
+      description.location = attribute.location;
+      description.format = attribute.format;
+      description.offset = attribute.offset;
+
+      descriptions.push_back(description);
+    }
+  };
+
+  if (format.stride != 0) {
+    add_attributes(0, format.attributes);
+  }
+  if (format.instance_stride != 0) {
+    add_attributes(1, format.instance_attributes);
+  }
+
+  return descriptions;
+}
+
+VkShaderModule create_shader_module(VkDevice device, const uint32_t *code,
+                                    size_t size,
+                                    const VkAllocationCallbacks *allocator) {
+  VkShaderModuleCreateInfo create_info{};
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = size;
+  create_info.pCode = code;
+
+  VkShaderModule shader_module;
+  if (vkCreateShaderModule(device, &create_info, allocator, &shader_module) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+
+  return shader_module;
+}
+
+VkPipeline
+create_graphics_pipeline(VkDevice device, VkPipelineCache pipeline_cache,
+                         const GraphicsPipelineDescription &description,
+                         const VkAllocationCallbacks *allocator) {
+  utils::trace::Scope scope("utils::pipeline::create_graphics_pipeline");
+
+  /** Get the shaders (embedded or mapped from the shader directory) */
+  auto vert_shader_code = utils::shader::get_shader(description.vertex_shader);
+  auto frag_shader_code =
+      utils::shader::get_shader(description.fragment_shader);
+
+  /** Create the shaders module */
+  VkShaderModule vert_shader_module = create_shader_module(
+      device, vert_shader_code->words(), vert_shader_code->size(), allocator);
+  VkShaderModule frag_shader_module = create_shader_module(
+      device, frag_shader_code->words(), frag_shader_code->size(), allocator);
+
+  /** Create the vertex shader */
+  VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
+  vert_shader_stage_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT; // vertex shader
+  vert_shader_stage_info.module = vert_shader_module;
+  vert_shader_stage_info.pName = "main";
+
+  /** Create the frag shader */
+  VkPipelineShaderStageCreateInfo frag_shader_stage_info{};
+  frag_shader_stage_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  frag_shader_stage_info.stage =
+      VK_SHADER_STAGE_FRAGMENT_BIT; // fragment shader
+  frag_shader_stage_info.module = frag_shader_module;
+  frag_shader_stage_info.pName = "main";
+
+  /** Shader stages */
+  std::vector<VkPipelineShaderStageCreateInfo> shader_stages = {
+      vert_shader_stage_info, frag_shader_stage_info};
+
+  /****************** */
+  /** Fixed functions */
+  /****************** */
+  // Image of the pipeline:
+  // https://vulkan-tutorial.com/images/vulkan_simplified_pipeline.svg
+
+  /** Vertex input */
+  // Derived from the vertex format: how the vertices are read from the bound
+  // vertex buffer (binding 0) and which shader input gets each attribute
+  // https://vulkan-tutorial.com/Vertex_buffers/Vertex_input_description
+  std::vector<VkVertexInputBindingDescription> binding_descriptions =
+      get_binding_descriptions(description.vertex_format);
+  std::vector<VkVertexInputAttributeDescription> attribute_descriptions =
+      get_attribute_descriptions(description.vertex_format);
+
+  VkPipelineVertexInputStateCreateInfo vertex_input_info{};
+  vertex_input_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input_info.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(binding_descriptions.size());
+  vertex_input_info.pVertexBindingDescriptions = binding_descriptions.data();
+  vertex_input_info.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(attribute_descriptions.size());
+  vertex_input_info.pVertexAttributeDescriptions =
+      attribute_descriptions.data();
+
+  /** Input assembly */
+  // Input assembly describe two things:
+  //  - what kind of geometry will be drawn from the vertices (topology);
+  //  - primitive restart enable or not (primitiveRestartEnable)
+  //    - This enable break the topology of _STRIP modes by using a special
+  //      index of 0xFFFF or 0xFFFFFFFF.
+  VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+  input_assembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly.topology = description.topology;
+  input_assembly.primitiveRestartEnable = VK_FALSE;
+
+  /** Dynamic state - set some variables that can be dynamic in the pipeline */
+  // If we want to change some variable that can be modified without recreating
+  // the pipeline, we can specify here. This will cause the configuration of
+  // these values to be ignored and required to specify the data at drawing
+  // time.
+
+  // States that can be modified:
+  // https://registry.khronos.org/vulkan/specs/latest/man/html/VkDynamicState.html
+  std::vector<VkDynamicState> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT,
+                                                VK_DYNAMIC_STATE_SCISSOR};
+
+  VkPipelineDynamicStateCreateInfo dynamic_state{};
+  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state.dynamicStateCount =
+      static_cast<uint32_t>(dynamic_states.size());
+  dynamic_state.pDynamicStates = dynamic_states.data();
+
+  /** Viewport and Scissor */
+  // Viewport(s) and scissor rectangle(s) can either be specified as a static
+  // part of the pipeline or as a dynamic state set in the command buffer, if
+  // not set to dynamic state, they need to be declared here and passed into the
+  // ViewportState.
+
+  /** Without dynamic state
+    // Viewport
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float) this->swap_chain_extent.width;
+    viewport.height = (float) this->swap_chain_extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    // Scissor
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = this->swap_chain_extent;
+  */
+
+  /** If used in the dynamic state, they will be set up at drawing time */
+  VkPipelineViewportStateCreateInfo viewport_state{};
+  viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.viewportCount = 1;
+  // viewport_state.pViewports = &viewport; // Without dynamic state
+  viewport_state.scissorCount = 1;
+  // viewport_state.pScissors = &scissor; // // Without dynamic state
+
+  /** Rasterizer */
+  // Takes the geometry that is shaped by the vertices from the vertex shader
+  // and turns it into fragments to be colored by the fragment shader. Also
+  // performs:
+  //  - Depth testing
+  //  - Face culling
+  //  - Scissor test
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  // Discart all the geometry (no fragments are generated)
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  // How fragments are generated for geometry (other mode than
+  // `VK_POLYGON_MODE_FILL` requires enabling a GPU feature)
+  // Ref of the polygonModes:
+  // https://registry.khronos.org/vulkan/specs/latest/man/html/VkPolygonMode.html
+  // List of common used:
+  //  - VK_POLYGON_MODE_FILL
+  //  - VK_POLYGON_MODE_LINE
+  //  - VK_POLYGON_MODE_POINT
+  rasterizer.polygonMode = description.polygon_mode;
+
+  // If `lineWidth > 1.0f` need to enable feature `wideLines`
+  rasterizer.lineWidth = 1.0f;
+
+  // Cull mode and front face (Specify what face to be cull and the orientation
+  // to be considered Front and Back face)
+  rasterizer.cullMode = description.cull_mode;
+  rasterizer.frontFace = description.front_face;
+
+  // Don't used for now
+  // https://vulkan-tutorial.com/en/Drawing_a_triangle/Graphics_pipeline_basics/Fixed_functions
+  //  - Last topic of Rasterizer
+  rasterizer.depthBiasEnable = VK_FALSE;
+  rasterizer.depthBiasConstantFactor = 0.0f; // Optional
+  rasterizer.depthBiasClamp = 0.0f;          // Optional
+  rasterizer.depthBiasSlopeFactor = 0.0f;    // Optional
+
+  /** Multisampling */
+  // Combine the fragment shader results of multiple polygons that rasterize to
+  // the same pixel (requires enabling a GPU feature).
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;          // Optional
+  multisampling.pSampleMask = nullptr;            // Optional
+  multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
+  multisampling.alphaToOneEnable = VK_FALSE;      // Optional
+
+  /** Color blending */
+  // After a fragment shader has returned a color, it combined with the color
+  // that is already in the framebuffer
+
+  // Configuration per attached framebuffer
+  VkPipelineColorBlendAttachmentState color_blend_attachment{};
+  // No blending
+  color_blend_attachment.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  // If set to true, it will apply a mask based on the `colorWriteMask` channels
+  // of the framebuffer.
+  // This are commonly used using oppacity (like glass or something like that)
+
+  // Example: This blending mode ignore whatever is in the framebuffer and just
+  // write the fragment color directly to the framebuffer.
+  color_blend_attachment.blendEnable = description.blend_enable;
+  color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
+  color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+  color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;             // Optional
+  color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;  // Optional
+  color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+  color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;             // Optional
+
+  // Global color blending settings
+  VkPipelineColorBlendStateCreateInfo color_blending{};
+  color_blending.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  color_blending.logicOpEnable = VK_FALSE;
+  color_blending.logicOp = VK_LOGIC_OP_COPY; // Optional
+
+  color_blending.attachmentCount = 1;
+  color_blending.pAttachments = &color_blend_attachment;
+
+  color_blending.blendConstants[0] = 0.0f; // Optional
+  color_blending.blendConstants[1] = 0.0f; // Optional
+  color_blending.blendConstants[2] = 0.0f; // Optional
+  color_blending.blendConstants[3] = 0.0f; // Optional
+
+  /** Pipeline */
+  //
+  VkGraphicsPipelineCreateInfo pipeline_info{};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+  // Shader stages
+  pipeline_info.stageCount = static_cast<uint32_t>(shader_stages.size());
+  pipeline_info.pStages = shader_stages.data();
+
+  // Fixed function stage
+  pipeline_info.pVertexInputState = &vertex_input_info;
+  pipeline_info.pInputAssemblyState = &input_assembly;
+  pipeline_info.pViewportState = &viewport_state;
+  pipeline_info.pRasterizationState = &rasterizer;
+  pipeline_info.pMultisampleState = &multisampling;
+  pipeline_info.pDepthStencilState = nullptr; // Optional
+  pipeline_info.pColorBlendState = &color_blending;
+  pipeline_info.pDynamicState = &dynamic_state;
+
+  // Pipeline layout
+  pipeline_info.layout = description.layout;
+
+  // Render pass
+  // Define the index of the sub pass where this graphics pipeline will be used
+  // based on the `render_pass`.
+  pipeline_info.renderPass = description.render_pass;
+  pipeline_info.subpass = description.subpass;
+
+  // Pipeline derivatives
+  // Used to create a new pipeline by deriving from an existing pipeline.
+  pipeline_info.basePipelineHandle = VK_NULL_HANDLE; // Optional
+  pipeline_info.basePipelineIndex = -1;              // Optional
+
+  // Quick compile of a placeholder (used until the optimized one is ready)
+  if (description.disable_optimization) {
+    pipeline_info.flags |= VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT;
+  }
+
+  // Compiled from the cache when it already has the pipeline. The cache is
+  // internally synchronized, so many threads can compile with it at once.
+  auto compile_start = std::chrono::steady_clock::now();
+  VkPipeline pipeline;
+  VkResult result = vkCreateGraphicsPipelines(device, pipeline_cache, 1,
+                                              &pipeline_info, allocator,
+                                              &pipeline);
+
+  /** Destroy the shaders when the pipeline is created */
+  vkDestroyShaderModule(device, vert_shader_module, allocator);
+  vkDestroyShaderModule(device, frag_shader_module, allocator);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create graphics pipeline!");
+  }
+
+  utils::trace::out() << "Graphics pipeline " << description.name
+                      << " created in "
+                      << std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - compile_start)
+                             .count()
+                      << " ms" << std::endl;
+
+  return pipeline;
+}
+
+VkPipeline create_compute_pipeline(VkDevice device,
+                                   VkPipelineCache pipeline_cache,
+                                   const std::string &shader,
+                                   VkPipelineLayout layout,
+                                   const VkAllocationCallbacks *allocator) {
+  utils::trace::Scope scope("utils::pipeline::create_compute_pipeline");
+
+  auto shader_code = utils::shader::get_shader(shader);
+  VkShaderModule shader_module = create_shader_module(
+      device, shader_code->words(), shader_code->size(), allocator);
+
+  VkComputePipelineCreateInfo pipeline_info{};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = shader_module;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = layout;
+
+  VkPipeline pipeline;
+  VkResult result = vkCreateComputePipelines(device, pipeline_cache, 1,
+                                             &pipeline_info, allocator,
+                                             &pipeline);
+
+  vkDestroyShaderModule(device, shader_module, allocator);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+
+  utils::trace::out() << "Compute pipeline " << shader << " created"
+                      << std::endl;
+
+  return pipeline;
+}
+
+PipelineHandle::PipelineHandle(std::shared_future<VkPipeline> pipeline)
+    : pipeline(std::move(pipeline)) {}
+
+bool PipelineHandle::valid() const { return this->pipeline.valid(); }
+
+bool PipelineHandle::is_ready() const {
+  return this->pipeline.valid() &&
+         this->pipeline.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+}
+
+VkPipeline PipelineHandle::get() const { return this->pipeline.get(); }
+
+VkPipeline PipelineHandle::get_or(VkPipeline placeholder) const {
+  return this->is_ready() ? this->pipeline.get() : placeholder;
+}
+
+PipelineBuilder::PipelineBuilder(VkDevice device,
+                                 VkPipelineCache pipeline_cache,
+                                 size_t thread_count,
+                                 const VkAllocationCallbacks *allocator)
+    : device(device), pipeline_cache(pipeline_cache), allocator(allocator) {
+  if (thread_count > 0) {
+    this->threads =
+        std::make_unique<utils::thread_pool::ThreadPool>(thread_count);
+  }
+}
+
+PipelineHandle
+PipelineBuilder::submit(const GraphicsPipelineDescription &description) {
+  VkDevice device = this->device;
+  VkPipelineCache pipeline_cache = this->pipeline_cache;
+  const VkAllocationCallbacks *allocator = this->allocator;
+
+  // Without workers the pipeline is compiled now (the handle is ready)
+  if (!this->threads) {
+    std::promise<VkPipeline> promise;
+    try {
+      promise.set_value(create_graphics_pipeline(device, pipeline_cache,
+                                                 description, allocator));
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+
+    return PipelineHandle(promise.get_future().share());
+  }
+
+  // The description is copied, the caller can reuse it right away
+  return PipelineHandle(
+      this->threads
+          ->submit([device, pipeline_cache, description, allocator]() {
+            return create_graphics_pipeline(device, pipeline_cache,
+                                            description, allocator);
+          })
+          .share());
+}
+
+std::vector<PipelineHandle> PipelineBuilder::submit(
+    const std::vector<GraphicsPipelineDescription> &descriptions) {
+  std::vector<PipelineHandle> handles;
+  handles.reserve(descriptions.size());
+
+  for (const auto &description : descriptions) {
+    handles.push_back(this->submit(description));
+  }
+
+  return handles;
+}
+
+VkPipeline
+PipelineBuilder::build(const GraphicsPipelineDescription &description) {
+  return create_graphics_pipeline(this->device, this->pipeline_cache,
+                                  description, this->allocator);
+}
+
+size_t PipelineBuilder::thread_count() const {
+  return this->threads ? this->threads->size() : 0;
+}
+} // namespace pipeline
+} // namespace utils
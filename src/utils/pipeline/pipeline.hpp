@@ -0,0 +1,138 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../thread_pool/thread_pool.hpp"
+
+namespace utils {
+namespace pipeline {
+/** Input of the vertex shader (`layout(location = ...) in`) */
+struct VertexAttribute {
+  uint32_t location = 0;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  // Bytes from the start of the vertex
+  uint32_t offset = 0;
+};
+
+/** Layout of the vertices of the vertex buffer (binding 0) and of the
+ * instances of the instance buffer (binding 1) */
+struct VertexFormat {
+  // Bytes between two vertices (0 = no vertex buffer)
+  uint32_t stride = 0;
+  std::vector<VertexAttribute> attributes;
+
+  // Bytes between two instances (0 = no instance buffer)
+  uint32_t instance_stride = 0;
+  std::vector<VertexAttribute> instance_attributes;
+};
+
+// Input state of the buffers described by `format` (only the bindings with
+// a stride)
+std::vector<VkVertexInputBindingDescription>
+get_binding_descriptions(const VertexFormat &format);
+std::vector<VkVertexInputAttributeDescription>
+get_attribute_descriptions(const VertexFormat &format);
+
+/** What varies between the graphics pipelines (the rest of the fixed
+ * functions is shared) */
+struct GraphicsPipelineDescription {
+  // Used in the logs
+  std::string name;
+
+  // Shader names (`utils::shader::get_shader`)
+  std::string vertex_shader;
+  std::string fragment_shader;
+
+  VertexFormat vertex_format;
+
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+  // Other mode than `VK_POLYGON_MODE_FILL` requires `fillModeNonSolid`
+  VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+  VkBool32 blend_enable = VK_FALSE;
+
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+
+  // Compile faster but run slower (placeholder pipelines)
+  bool disable_optimization = false;
+};
+
+// `code` must be aligned on 4 bytes (`size` in bytes)
+VkShaderModule create_shader_module(VkDevice device, const uint32_t *code,
+                                    size_t size,
+                                    const VkAllocationCallbacks *allocator);
+
+// Compile the pipeline on the calling thread
+VkPipeline
+create_graphics_pipeline(VkDevice device, VkPipelineCache pipeline_cache,
+                         const GraphicsPipelineDescription &description,
+                         const VkAllocationCallbacks *allocator);
+
+// Compile the compute shader `shader` (`utils::shader::get_shader`) on the
+// calling thread
+VkPipeline create_compute_pipeline(VkDevice device,
+                                   VkPipelineCache pipeline_cache,
+                                   const std::string &shader,
+                                   VkPipelineLayout layout,
+                                   const VkAllocationCallbacks *allocator);
+
+/** Pipeline that may still be compiling */
+class PipelineHandle {
+public:
+  PipelineHandle() = default;
+  explicit PipelineHandle(std::shared_future<VkPipeline> pipeline);
+
+  // If the handle refers to a submitted pipeline
+  bool valid() const;
+  // If the compilation is done (non-blocking)
+  bool is_ready() const;
+  // Wait for the compilation, rethrows its error
+  VkPipeline get() const;
+  // The pipeline if ready, otherwise `placeholder`
+  VkPipeline get_or(VkPipeline placeholder) const;
+
+private:
+  std::shared_future<VkPipeline> pipeline;
+};
+
+/** Compile graphics pipelines on worker threads with a shared cache */
+// The pipelines belong to the caller (destroyed with `vkDestroyPipeline`).
+// Destroying the builder waits for the submitted compilations.
+class PipelineBuilder {
+public:
+  // `thread_count` 0 compiles on the calling thread during `submit()`.
+  // `allocator` must outlive the builder (thread-safe).
+  PipelineBuilder(VkDevice device, VkPipelineCache pipeline_cache,
+                  size_t thread_count, const VkAllocationCallbacks *allocator);
+
+  PipelineHandle submit(const GraphicsPipelineDescription &description);
+  std::vector<PipelineHandle>
+  submit(const std::vector<GraphicsPipelineDescription> &descriptions);
+
+  // Compile on the calling thread (e.g. a placeholder needed right away)
+  VkPipeline build(const GraphicsPipelineDescription &description);
+
+  size_t thread_count() const;
+
+private:
+  VkDevice device;
+  VkPipelineCache pipeline_cache;
+  const VkAllocationCallbacks *allocator;
+
+  // `nullptr` when compiling on the calling thread
+  std::unique_ptr<utils::thread_pool::ThreadPool> threads;
+};
+} // namespace pipeline
+} // namespace utils
+
+#endif
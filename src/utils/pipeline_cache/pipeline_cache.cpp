@@ -0,0 +1,217 @@
+#include "pipeline_cache.hpp"
+
+#include "../trace/trace.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace utils {
+namespace pipeline_cache {
+/** Header written before the data returned by `vkGetPipelineCacheData` */
+// The data has its own header (vendor, device and cache UUID) but not the
+// driver version, and nothing detects a truncated file
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+  // Written raw: the padding before `data_size` is an explicit (zeroed)
+  // field, so the file doesn't depend on uninitialized bytes
+  uint32_t reserved;
+  uint64_t data_size;
+  // FNV-1a of the data
+  uint64_t data_hash;
+};
+static_assert(sizeof(FileHeader) == 56, "FileHeader has implicit padding");
+
+static const char file_magic[4] = {'L', 'V', 'K', 'P'};
+static const uint32_t file_version = 1;
+
+static uint64_t hash_data(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 1099511628211ull;
+  }
+
+  return hash;
+}
+
+static FileHeader make_header(const VkPhysicalDeviceProperties &properties) {
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.vendor_id = properties.vendorID;
+  header.device_id = properties.deviceID;
+  header.driver_version = properties.driverVersion;
+  std::memcpy(header.pipeline_cache_uuid, properties.pipelineCacheUUID,
+              VK_UUID_SIZE);
+
+  return header;
+}
+
+/** Read the data of the cache file, empty if it can't be used */
+static std::vector<char>
+read_cache_data(const VkPhysicalDeviceProperties &properties,
+                const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    utils::trace::out() << "Pipeline cache: no file at " << path << std::endl;
+    return {};
+  }
+
+  FileHeader header{};
+  FileHeader expected = make_header(properties);
+
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+      header.version != expected.version) {
+    utils::trace::out() << "Pipeline cache: invalid file " << path << std::endl;
+    return {};
+  }
+
+  // A driver update (or another GPU) invalidates the cached binaries
+  if (header.vendor_id != expected.vendor_id ||
+      header.device_id != expected.device_id ||
+      header.driver_version != expected.driver_version ||
+      std::memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid,
+                  VK_UUID_SIZE) != 0) {
+    utils::trace::out() << "Pipeline cache: written by another device or driver"
+                        << std::endl;
+    return {};
+  }
+
+  // Checked against the rest of the file before allocating: a corrupted
+  // size must not allocate (or throw) more than the file holds
+  std::streampos data_start = file.tellg();
+  file.seekg(0, std::ios::end);
+  std::streamoff remaining = file.tellg() - data_start;
+  file.seekg(data_start);
+
+  if (!file || remaining < 0 ||
+      header.data_size != static_cast<uint64_t>(remaining)) {
+    utils::trace::out() << "Pipeline cache: corrupted file " << path
+                        << std::endl;
+    return {};
+  }
+
+  std::vector<char> data(header.data_size);
+  if (!file.read(data.data(), data.size()) ||
+      hash_data(data.data(), data.size()) != header.data_hash) {
+    utils::trace::out() << "Pipeline cache: corrupted file " << path
+                        << std::endl;
+    return {};
+  }
+
+  return data;
+}
+
+std::string get_default_directory() {
+  // Relative values are invalid (XDG Base Directory specification)
+  const char *cache_home = std::getenv("XDG_CACHE_HOME");
+  if (cache_home != nullptr && cache_home[0] == '/') {
+    return std::string(cache_home) + "/lvk/pipeline_cache";
+  }
+
+  const char *home = std::getenv("HOME");
+  if (home != nullptr && home[0] != '\0') {
+    return std::string(home) + "/.cache/lvk/pipeline_cache";
+  }
+
+  return "build/pipeline_cache";
+}
+
+std::string
+get_pipeline_cache_path(const VkPhysicalDeviceProperties &properties,
+                        const std::string &directory) {
+  std::ostringstream path;
+  path << directory << "/pipeline_cache_" << std::hex << std::setfill('0')
+       << std::setw(4) << properties.vendorID << "_" << std::setw(4)
+       << properties.deviceID << ".bin";
+
+  return path.str();
+}
+
+VkPipelineCache
+load_pipeline_cache(VkDevice device,
+                    const VkPhysicalDeviceProperties &properties,
+                    const std::string &path,
+                    const VkAllocationCallbacks *allocator) {
+  utils::trace::Scope scope("utils::pipeline_cache::load_pipeline_cache");
+
+  std::vector<char> data = read_cache_data(properties, path);
+
+  // The driver also checks the data (and ignores it if incompatible)
+  VkPipelineCacheCreateInfo create_info{};
+  create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  create_info.initialDataSize = data.size();
+  create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+  VkPipelineCache pipeline_cache;
+  if (vkCreatePipelineCache(device, &create_info, allocator, &pipeline_cache) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+
+  utils::trace::out() << "Pipeline cache: loaded " << data.size() << " bytes"
+                      << std::endl;
+
+  return pipeline_cache;
+}
+
+void save_pipeline_cache(VkDevice device,
+                         const VkPhysicalDeviceProperties &properties,
+                         VkPipelineCache pipeline_cache,
+                         const std::string &path) {
+  utils::trace::Scope scope("utils::pipeline_cache::save_pipeline_cache");
+
+  size_t data_size = 0;
+  if (vkGetPipelineCacheData(device, pipeline_cache, &data_size, nullptr) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to get pipeline cache data!");
+  }
+
+  std::vector<char> data(data_size);
+  if (vkGetPipelineCacheData(device, pipeline_cache, &data_size,
+                             data.data()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to get pipeline cache data!");
+  }
+  data.resize(data_size);
+
+  FileHeader header = make_header(properties);
+  header.data_size = data.size();
+  header.data_hash = hash_data(data.data(), data.size());
+
+  std::filesystem::path file_path(path);
+  if (file_path.has_parent_path()) {
+    std::filesystem::create_directories(file_path.parent_path());
+  }
+
+  // Written next to the file and renamed over it
+  std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open() ||
+        !file.write(reinterpret_cast<const char *>(&header), sizeof(header)) ||
+        !file.write(data.data(), data.size())) {
+      throw std::runtime_error("failed to write pipeline cache!");
+    }
+  }
+
+  std::filesystem::rename(temporary_path, path);
+
+  utils::trace::out() << "Pipeline cache: saved " << data.size() << " bytes to "
+                      << path << std::endl;
+}
+} // namespace pipeline_cache
+} // namespace utils
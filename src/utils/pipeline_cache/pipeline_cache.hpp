@@ -0,0 +1,37 @@
+#ifndef PIPELINE_CACHE_HPP
+#define PIPELINE_CACHE_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <string>
+
+namespace utils {
+namespace pipeline_cache {
+// `$XDG_CACHE_HOME/lvk/pipeline_cache` (`~/.cache` when not set), so the
+// cache doesn't depend on the working directory. `build/pipeline_cache` if
+// neither is set.
+std::string get_default_directory();
+
+// File of the cache of a physical device inside `directory` (one file per
+// vendor and device, so several GPUs don't overwrite each other)
+std::string
+get_pipeline_cache_path(const VkPhysicalDeviceProperties &properties,
+                        const std::string &directory);
+
+// Pipeline cache filled with the file at `path`, empty if the file is missing
+// or was written by another device, driver version or cache UUID
+VkPipelineCache
+load_pipeline_cache(VkDevice device,
+                    const VkPhysicalDeviceProperties &properties,
+                    const std::string &path,
+                    const VkAllocationCallbacks *allocator);
+// Write the cache to `path` (replaced atomically, a crash while saving keeps
+// the previous file)
+void save_pipeline_cache(VkDevice device,
+                         const VkPhysicalDeviceProperties &properties,
+                         VkPipelineCache pipeline_cache,
+                         const std::string &path);
+} // namespace pipeline_cache
+} // namespace utils
+
+#endif
@@ -1,13 +1,13 @@
 #include "queue.hpp"
 
+#include "../trace/trace.hpp"
+
 #include <vector>
 
 namespace utils {
 namespace queue {
-QueueFamilyIndices find_queue_families(VkPhysicalDevice device,
-                                       VkSurfaceKHR surface) {
-  QueueFamilyIndices indices;
-
+std::vector<VkQueueFamilyProperties>
+get_queue_families(VkPhysicalDevice device) {
   uint32_t queueFamilyCount = 0;
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
 
@@ -15,11 +15,25 @@ QueueFamilyIndices find_queue_families(VkPhysicalDevice device,
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
                                            queue_families.data());
 
+  return queue_families;
+}
+
+QueueFamilyIndices find_queue_families(
+    VkPhysicalDevice device, VkSurfaceKHR surface,
+    const std::vector<VkQueueFamilyProperties> &queue_families) {
+  utils::trace::Scope scope("utils::queue::find_queue_families");
+
+  QueueFamilyIndices indices;
+
   for (size_t i = 0; i < queue_families.size(); ++i) {
     const auto &queue_family = queue_families[i];
 
+    // Without a surface (headless) there is nothing to present to
     VkBool32 present_support = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+    if (surface != VK_NULL_HANDLE) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface,
+                                           &present_support);
+    }
 
     if ((queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
       indices.graphics_family = i;
@@ -29,11 +43,30 @@ QueueFamilyIndices find_queue_families(VkPhysicalDevice device,
       indices.present_family = i;
     }
 
-    if (indices.is_complete()) {
+    if (indices.is_complete() ||
+        (surface == VK_NULL_HANDLE && indices.is_complete_headless())) {
       break;
     }
   }
 
+  // Dedicated transfer family: the DMA engines on most discrete GPUs, else
+  // a compute family (still asynchronous to the graphics queue)
+  for (size_t i = 0; i < queue_families.size(); ++i) {
+    VkQueueFlags flags = queue_families[i].queueFlags;
+    if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+
+    if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+      indices.transfer_family = i;
+      break;
+    }
+
+    if (!indices.transfer_family.has_value()) {
+      indices.transfer_family = i;
+    }
+  }
+
   return indices;
 }
 } // namespace queue
@@ -2,22 +2,32 @@
 #define QUEUE_HPP
 
 #include <optional>
+#include <vector>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphics_family;
   std::optional<uint32_t> present_family;
+  // Family without graphics (transfer only if there is one), for uploads
+  // running alongside the rendering
+  std::optional<uint32_t> transfer_family;
 
   bool is_complete() const {
     return graphics_family.has_value() && present_family.has_value();
   }
+
+  // Headless rendering only needs to draw, never to present
+  bool is_complete_headless() const { return graphics_family.has_value(); }
 };
 
 namespace utils {
 namespace queue {
-QueueFamilyIndices find_queue_families(VkPhysicalDevice device,
-                                       VkSurfaceKHR surface);
+std::vector<VkQueueFamilyProperties>
+get_queue_families(VkPhysicalDevice device);
+QueueFamilyIndices
+find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface,
+                    const std::vector<VkQueueFamilyProperties> &queue_families);
 } // namespace queue
 } // namespace utils
 
@@ -0,0 +1,207 @@
+#include "shader.hpp"
+
+#include "../trace/trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace utils {
+namespace shader {
+// Header of a SPIR-V module: magic, version, generator, bound and schema
+static const size_t spirv_header_size = 5 * sizeof(uint32_t);
+
+ShaderBlob::ShaderBlob(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    throw std::runtime_error("failed to open " + path + ": " +
+                             std::strerror(errno));
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) == -1) {
+    close(fd);
+    throw std::runtime_error("failed to stat " + path);
+  }
+
+  // `mmap` fails on an empty file, let the validation report it
+  if (static_cast<size_t>(status.st_size) < spirv_header_size) {
+    close(fd);
+    validate_spirv(nullptr, static_cast<size_t>(status.st_size), path);
+  }
+
+  size_t size = static_cast<size_t>(status.st_size);
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("failed to map " + path + ": " +
+                             std::strerror(errno));
+  }
+
+  try {
+    validate_spirv(mapping, size, path);
+  } catch (...) {
+    munmap(mapping, size);
+    throw;
+  }
+
+  // Read once by `vkCreateShaderModule`
+  madvise(mapping, size, MADV_SEQUENTIAL);
+
+  this->data = static_cast<const uint32_t *>(mapping);
+  this->data_size = size;
+  this->mapped = true;
+}
+
+ShaderBlob::ShaderBlob(const uint32_t *words, size_t size,
+                       const std::string &name)
+    : data(words), data_size(size) {
+  validate_spirv(words, size, name);
+}
+
+ShaderBlob::~ShaderBlob() {
+  if (this->mapped) {
+    munmap(const_cast<uint32_t *>(this->data), this->data_size);
+  }
+}
+
+const uint32_t *ShaderBlob::words() const { return this->data; }
+
+size_t ShaderBlob::size() const { return this->data_size; }
+
+void validate_spirv(const void *data, size_t size, const std::string &name) {
+  if (size < spirv_header_size || size % sizeof(uint32_t) != 0) {
+    throw std::runtime_error("invalid SPIR-V size (" + std::to_string(size) +
+                             " bytes): " + name);
+  }
+
+  if (reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+    throw std::runtime_error("SPIR-V is not aligned on 4 bytes: " + name);
+  }
+
+  uint32_t magic = *static_cast<const uint32_t *>(data);
+  if (magic == __builtin_bswap32(spirv_magic)) {
+    throw std::runtime_error("SPIR-V has the wrong byte order: " + name);
+  }
+  if (magic != spirv_magic) {
+    throw std::runtime_error("invalid SPIR-V magic number: " + name);
+  }
+}
+
+/** Cached mapping and the file it was mapped from */
+struct CacheEntry {
+  std::shared_ptr<const ShaderBlob> blob;
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  struct timespec modified;
+};
+
+static std::mutex cache_mutex;
+static std::unordered_map<std::string, CacheEntry> cache;
+// Guarded by `cache_mutex`
+static std::string shader_directory;
+
+static bool is_same_file(const CacheEntry &entry, const struct stat &status) {
+  return entry.device == status.st_dev && entry.inode == status.st_ino &&
+         entry.size == status.st_size &&
+         entry.modified.tv_sec == status.st_mtim.tv_sec &&
+         entry.modified.tv_nsec == status.st_mtim.tv_nsec;
+}
+
+std::shared_ptr<const ShaderBlob> load_shader(const std::string &path) {
+  struct stat status;
+  if (stat(path.c_str(), &status) == -1) {
+    throw std::runtime_error("failed to open " + path + ": " +
+                             std::strerror(errno));
+  }
+
+  std::lock_guard<std::mutex> lock(cache_mutex);
+
+  auto found = cache.find(path);
+  if (found != cache.end() && is_same_file(found->second, status)) {
+    return found->second.blob;
+  }
+
+  // A blob still used keeps the old mapping (and file contents) alive
+  CacheEntry entry;
+  entry.blob = std::make_shared<const ShaderBlob>(path);
+  entry.device = status.st_dev;
+  entry.inode = status.st_ino;
+  entry.size = status.st_size;
+  entry.modified = status.st_mtim;
+
+  utils::trace::out() << "Shader mapped: " << path << " (" << entry.size
+                      << " bytes)" << std::endl;
+
+  cache[path] = entry;
+
+  return entry.blob;
+}
+
+void clear_shader_cache() {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  cache.clear();
+}
+
+void set_shader_directory(const std::string &directory) {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  shader_directory = directory;
+}
+
+std::shared_ptr<const ShaderBlob> get_shader(const std::string &name) {
+  std::string directory;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    directory = shader_directory;
+  }
+
+  if (!directory.empty()) {
+    return load_shader(directory + "/" + name + ".spv");
+  }
+
+  const EmbeddedShader *end = embedded_shaders + embedded_shader_count;
+  const EmbeddedShader *found = std::lower_bound(
+      embedded_shaders, end, name,
+      [](const EmbeddedShader &shader, const std::string &name) {
+        return std::strcmp(shader.name, name.c_str()) < 0;
+      });
+
+  if (found == end || name != found->name) {
+    throw std::runtime_error("no embedded shader named " + name);
+  }
+
+  // The words are static, nothing to cache
+  return std::make_shared<const ShaderBlob>(found->words, found->size, name);
+}
+
+void compile_glsl(const std::string &source, const std::string &output) {
+  // The errors of `glslc` go to stderr
+  std::string temporary = output + ".tmp";
+  std::string command = "glslc '" + source + "' -o '" + temporary + "'";
+
+  if (std::system(command.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("failed to compile " + source);
+  }
+
+  if (std::rename(temporary.c_str(), output.c_str()) != 0) {
+    throw std::runtime_error("failed to replace " + output);
+  }
+
+  utils::trace::out() << "Shader compiled: " << source << " -> " << output
+                      << std::endl;
+}
+} // namespace shader
+} // namespace utils
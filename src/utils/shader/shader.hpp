@@ -0,0 +1,76 @@
+#ifndef SHADER_HPP
+#define SHADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace utils {
+namespace shader {
+// First word of every SPIR-V module (in the host byte order)
+const uint32_t spirv_magic = 0x07230203;
+
+/** SPIR-V module in memory: a file mapped read-only or embedded words */
+// The words are passed as is to `vkCreateShaderModule` (no copy): a mapping
+// starts on a page boundary, so it is aligned for `uint32_t`. A file rewritten
+// in place while it is read is undefined, compilers should replace it.
+class ShaderBlob {
+public:
+  // Throws if the file can't be mapped or isn't a SPIR-V module
+  explicit ShaderBlob(const std::string &path);
+  // Words that outlive the blob (not copied), `size` in bytes
+  ShaderBlob(const uint32_t *words, size_t size, const std::string &name);
+  ~ShaderBlob();
+
+  ShaderBlob(const ShaderBlob &) = delete;
+  ShaderBlob &operator=(const ShaderBlob &) = delete;
+
+  const uint32_t *words() const;
+  // In bytes (`VkShaderModuleCreateInfo::codeSize`)
+  size_t size() const;
+
+private:
+  const uint32_t *data = nullptr;
+  size_t data_size = 0;
+  // If `data` is a mapping (unmapped by the destructor)
+  bool mapped = false;
+};
+
+/** SPIR-V compiled into the executable (generated by `embed_shaders.sh`) */
+struct EmbeddedShader {
+  // GLSL file name (e.g. "shader.vert")
+  const char *name;
+  const uint32_t *words;
+  // In bytes
+  size_t size;
+};
+
+// Sorted by name (`strcmp`), followed by an empty entry
+extern const EmbeddedShader embedded_shaders[];
+extern const size_t embedded_shader_count;
+
+// Throws if `data` isn't a SPIR-V module that can be given to
+// `vkCreateShaderModule` (word aligned, whole words, magic number)
+void validate_spirv(const void *data, size_t size, const std::string &name);
+
+// Mapped SPIR-V file, shared with the previous loads of `path` while the file
+// is unchanged (mapped again when it is modified). Thread-safe.
+std::shared_ptr<const ShaderBlob> load_shader(const std::string &path);
+// Forget the cached mappings (unmapped once the blobs are no longer used)
+void clear_shader_cache();
+
+// Directory of the SPIR-V files used instead of the embedded ones ("" = use
+// the embedded shaders)
+void set_shader_directory(const std::string &directory);
+// Shader `name` (its GLSL file name): `<directory>/<name>.spv` when a
+// directory is set, otherwise the embedded SPIR-V. Thread-safe.
+std::shared_ptr<const ShaderBlob> get_shader(const std::string &name);
+
+// Compile a GLSL file with `glslc` into `output`. The file is replaced once
+// compiled (a mapping of the previous one stays valid). Throws if it fails.
+void compile_glsl(const std::string &source, const std::string &output);
+} // namespace shader
+} // namespace utils
+
+#endif
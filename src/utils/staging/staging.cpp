@@ -0,0 +1,407 @@
+#include "staging.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace utils {
+namespace staging {
+// Alignment of the data in the ring
+static const VkDeviceSize copy_alignment = 16;
+
+static VkCommandPool
+create_command_pool(VkDevice device, uint32_t family,
+                    const VkAllocationCallbacks *allocator) {
+  // Recorded once per batch, then reset when the slot is reused
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                    VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = family;
+
+  VkCommandPool command_pool;
+  if (vkCreateCommandPool(device, &pool_info, allocator, &command_pool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create staging command pool!");
+  }
+
+  return command_pool;
+}
+
+static VkCommandBuffer allocate_command_buffer(VkDevice device,
+                                               VkCommandPool command_pool) {
+  VkCommandBufferAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.commandPool = command_pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandBufferCount = 1;
+
+  VkCommandBuffer command_buffer;
+  if (vkAllocateCommandBuffers(device, &alloc_info, &command_buffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate staging command buffer!");
+  }
+
+  return command_buffer;
+}
+
+static void begin_command_buffer(VkCommandBuffer command_buffer) {
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin staging command buffer!");
+  }
+}
+
+StagingRing::StagingRing(VkDevice device,
+                         memory::DeviceAllocator &device_allocator,
+                         uint32_t transfer_family, VkQueue transfer_queue,
+                         uint32_t graphics_family, VkQueue graphics_queue,
+                         VkDeviceSize size,
+                         const VkAllocationCallbacks *allocator)
+    : device(device), device_allocator(device_allocator),
+      transfer_family(transfer_family), transfer_queue(transfer_queue),
+      graphics_family(graphics_family), graphics_queue(graphics_queue),
+      allocator(allocator), size(size), batches(batch_count) {
+  /** Ring buffer (written by the CPU, read by the copies) */
+  VkBufferCreateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = size;
+  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // Coherent, so the writes don't have to be flushed
+  this->buffer = this->device_allocator.create_buffer(
+      buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  /** Command buffers and synchronization of the batches */
+  this->command_pool =
+      create_command_pool(this->device, transfer_family, this->allocator);
+  if (this->is_asynchronous()) {
+    this->acquire_command_pool =
+        create_command_pool(this->device, graphics_family, this->allocator);
+  }
+
+  VkFenceCreateInfo fence_info{};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VkSemaphoreCreateInfo semaphore_info{};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for (auto &batch : this->batches) {
+    batch.command_buffer =
+        allocate_command_buffer(this->device, this->command_pool);
+    if (vkCreateFence(this->device, &fence_info, this->allocator,
+                      &batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create staging fence!");
+    }
+
+    if (!this->is_asynchronous()) {
+      continue;
+    }
+
+    batch.acquire_command_buffer =
+        allocate_command_buffer(this->device, this->acquire_command_pool);
+    if (vkCreateFence(this->device, &fence_info, this->allocator,
+                      &batch.acquire_fence) != VK_SUCCESS ||
+        vkCreateSemaphore(this->device, &semaphore_info, this->allocator,
+                          &batch.semaphore) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create staging hand-off!");
+    }
+  }
+}
+
+StagingRing::~StagingRing() {
+  for (size_t index : this->submitted) {
+    vkWaitForFences(this->device, 1, &this->batches[index].fence, VK_TRUE,
+                    UINT64_MAX);
+  }
+
+  for (size_t index : this->handed_off) {
+    VkFence fence = this->get_completion_fence(this->batches[index]);
+    vkWaitForFences(this->device, 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+
+  for (auto &batch : this->batches) {
+    vkDestroyFence(this->device, batch.fence, this->allocator);
+
+    if (this->is_asynchronous()) {
+      vkDestroyFence(this->device, batch.acquire_fence, this->allocator);
+      vkDestroySemaphore(this->device, batch.semaphore, this->allocator);
+    }
+  }
+
+  // Frees the command buffers
+  vkDestroyCommandPool(this->device, this->command_pool, this->allocator);
+  if (this->acquire_command_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(this->device, this->acquire_command_pool,
+                         this->allocator);
+  }
+  this->device_allocator.destroy_buffer(this->buffer);
+}
+
+uint64_t StagingRing::upload(VkBuffer buffer, VkDeviceSize offset,
+                             const void *data, VkDeviceSize size) {
+  const char *bytes = static_cast<const char *>(data);
+  uint64_t batch_number = this->ready_batch;
+
+  // Chunks of half the ring at most, so that a chunk always fits once the
+  // older batches are done
+  while (size > 0) {
+    VkDeviceSize chunk = std::min(size, this->size / 2);
+    VkDeviceSize position = this->allocate(chunk);
+
+    std::memcpy(static_cast<char *>(this->buffer.allocation.mapped) +
+                    position % this->size,
+                bytes, chunk);
+
+    Batch &batch = this->begin_batch();
+
+    VkBufferCopy region{};
+    region.srcOffset = position % this->size;
+    region.dstOffset = offset;
+    region.size = chunk;
+    vkCmdCopyBuffer(batch.command_buffer, this->buffer.buffer, buffer, 1,
+                    &region);
+
+    // Released by the transfer family, acquired by the graphics family
+    if (this->is_asynchronous()) {
+      VkBufferMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      barrier.srcQueueFamilyIndex = this->transfer_family;
+      barrier.dstQueueFamilyIndex = this->graphics_family;
+      barrier.buffer = buffer;
+      barrier.offset = offset;
+      barrier.size = chunk;
+      batch.barriers.push_back(barrier);
+    }
+
+    this->head = position + chunk;
+    batch.end = this->head;
+    batch_number = batch.number;
+
+    bytes += chunk;
+    offset += chunk;
+    size -= chunk;
+  }
+
+  return batch_number;
+}
+
+void StagingRing::flush() {
+  Batch &batch = this->batches[this->current];
+  if (!batch.recording) {
+    return;
+  }
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &batch.command_buffer;
+
+  if (this->is_asynchronous()) {
+    // Release: the copies are done before the ownership changes
+    for (auto &barrier : batch.barriers) {
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(batch.barriers.size()),
+                         batch.barriers.data(), 0, nullptr);
+
+    // Acquire: same ranges, visible to every command submitted after it
+    for (auto &barrier : batch.barriers) {
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    }
+    begin_command_buffer(batch.acquire_command_buffer);
+    vkCmdPipelineBarrier(batch.acquire_command_buffer,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(batch.barriers.size()),
+                         batch.barriers.data(), 0, nullptr);
+    if (vkEndCommandBuffer(batch.acquire_command_buffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record staging acquire!");
+    }
+    batch.barriers.clear();
+
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &batch.semaphore;
+  } else {
+    // The copies are done before any command submitted after them reads the
+    // buffers (vertex input, shaders, ...)
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier,
+                         0, nullptr, 0, nullptr);
+  }
+
+  if (vkEndCommandBuffer(batch.command_buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record staging command buffer!");
+  }
+
+  vkResetFences(this->device, 1, &batch.fence);
+  if (vkQueueSubmit(this->transfer_queue, 1, &submit_info, batch.fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit staging command buffer!");
+  }
+
+  batch.recording = false;
+  this->current = (this->current + 1) % this->batches.size();
+  ++this->submitted_batches;
+
+  // On the graphics queue, the commands submitted after are ordered with the
+  // copies by the barrier
+  if (this->is_asynchronous()) {
+    this->submitted.push_back(&batch - this->batches.data());
+  } else {
+    this->handed_off.push_back(&batch - this->batches.data());
+    this->ready_batch = batch.number;
+  }
+}
+
+void StagingRing::hand_off() {
+  // In order, so that the ready batches are all the batches up to one
+  while (!this->submitted.empty() &&
+         vkGetFenceStatus(this->device,
+                          this->batches[this->submitted.front()].fence) ==
+             VK_SUCCESS) {
+    this->submit_acquire();
+  }
+}
+
+uint64_t StagingRing::get_ready_batch() const { return this->ready_batch; }
+
+void StagingRing::wait_for_batch(uint64_t batch) {
+  const Batch &recording = this->batches[this->current];
+  if (recording.recording && recording.number <= batch) {
+    this->flush();
+  }
+
+  while (this->ready_batch < batch) {
+    this->retire_batches(true);
+  }
+}
+
+bool StagingRing::is_asynchronous() const {
+  return this->transfer_family != this->graphics_family;
+}
+
+uint64_t StagingRing::get_batch_count() const {
+  return this->submitted_batches;
+}
+
+uint64_t StagingRing::get_stall_count() const { return this->stalls; }
+
+VkDeviceSize StagingRing::allocate(VkDeviceSize size) {
+  this->retire_batches(false);
+
+  VkDeviceSize position =
+      (this->head + copy_alignment - 1) / copy_alignment * copy_alignment;
+
+  // A range is never split by the end of the ring
+  if (position % this->size + size > this->size) {
+    position = (position / this->size + 1) * this->size;
+  }
+
+  // Space used by the batches in flight (and the one being recorded)
+  while (position + size - this->tail > this->size) {
+    if (this->submitted.empty() && this->handed_off.empty()) {
+      this->flush();
+    }
+
+    ++this->stalls;
+    this->retire_batches(true);
+  }
+
+  return position;
+}
+
+void StagingRing::retire_batches(bool wait) {
+  // Nothing to wait for before the oldest batch is handed off
+  if (wait && this->handed_off.empty() && !this->submitted.empty()) {
+    vkWaitForFences(this->device, 1,
+                    &this->batches[this->submitted.front()].fence, VK_TRUE,
+                    UINT64_MAX);
+    this->submit_acquire();
+  }
+
+  while (!this->handed_off.empty()) {
+    Batch &batch = this->batches[this->handed_off.front()];
+    VkFence fence = this->get_completion_fence(batch);
+
+    // Wait for the oldest one only, the others are retired if already done
+    if (wait) {
+      vkWaitForFences(this->device, 1, &fence, VK_TRUE, UINT64_MAX);
+      wait = false;
+    } else if (vkGetFenceStatus(this->device, fence) != VK_SUCCESS) {
+      break;
+    }
+
+    this->tail = batch.end;
+    this->handed_off.pop_front();
+  }
+}
+
+StagingRing::Batch &StagingRing::begin_batch() {
+  Batch &batch = this->batches[this->current];
+  if (batch.recording) {
+    return batch;
+  }
+
+  // The slot is reused once its previous copies are done
+  auto in_flight = [this](const std::deque<size_t> &batches) {
+    return std::find(batches.begin(), batches.end(), this->current) !=
+           batches.end();
+  };
+  while (in_flight(this->submitted) || in_flight(this->handed_off)) {
+    ++this->stalls;
+    this->retire_batches(true);
+  }
+
+  begin_command_buffer(batch.command_buffer);
+  batch.recording = true;
+  batch.number = this->submitted_batches + 1;
+
+  return batch;
+}
+
+void StagingRing::submit_acquire() {
+  size_t index = this->submitted.front();
+  Batch &batch = this->batches[index];
+
+  // The copies are finished, so the wait doesn't block the graphics queue
+  VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.waitSemaphoreCount = 1;
+  submit_info.pWaitSemaphores = &batch.semaphore;
+  submit_info.pWaitDstStageMask = &wait_stage;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &batch.acquire_command_buffer;
+
+  vkResetFences(this->device, 1, &batch.acquire_fence);
+  if (vkQueueSubmit(this->graphics_queue, 1, &submit_info,
+                    batch.acquire_fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit staging acquire!");
+  }
+
+  this->submitted.pop_front();
+  this->handed_off.push_back(index);
+  this->ready_batch = batch.number;
+}
+
+VkFence StagingRing::get_completion_fence(const Batch &batch) const {
+  // The acquire waits for the copies
+  return this->is_asynchronous() ? batch.acquire_fence : batch.fence;
+}
+} // namespace staging
+} // namespace utils
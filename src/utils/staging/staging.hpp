@@ -0,0 +1,126 @@
+#ifndef STAGING_HPP
+#define STAGING_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "../memory/memory.hpp"
+
+namespace utils {
+namespace staging {
+/** Copies data to device local buffers through a mapped ring buffer */
+// The data is written in a host visible ring and copied by command buffers
+// submitted in batches. When the ring is full, only the oldest batch is
+// waited for (its fence), so an upload bigger than the ring streams through
+// it without idling the queue.
+//
+// With a transfer queue of another family than the graphics queue, the
+// copies run on the transfer queue while the graphics queue renders: each
+// batch releases the ownership of its buffers and signals a semaphore, the
+// graphics queue acquires them (waiting for the semaphore) once `hand_off()`
+// sees the batch finished, so it never waits for a copy in progress.
+class StagingRing {
+public:
+  // `transfer_queue` can be the graphics queue (same family, no hand-off)
+  StagingRing(VkDevice device, memory::DeviceAllocator &device_allocator,
+              uint32_t transfer_family, VkQueue transfer_queue,
+              uint32_t graphics_family, VkQueue graphics_queue,
+              VkDeviceSize size, const VkAllocationCallbacks *allocator);
+  // Waits for the submitted batches
+  ~StagingRing();
+
+  StagingRing(const StagingRing &) = delete;
+  StagingRing &operator=(const StagingRing &) = delete;
+
+  // Record the copy of `size` bytes of `data` to `buffer` at `offset` (`data`
+  // can be reused right away), returns the batch of the copy. `buffer` must
+  // be exclusive and not used by the graphics queue before the batch is
+  // ready.
+  uint64_t upload(VkBuffer buffer, VkDeviceSize offset, const void *data,
+                  VkDeviceSize size);
+  // Submit the recorded copies (nothing to do if there are none)
+  void flush();
+  // Make the finished batches usable by the graphics queue (never waits)
+  void hand_off();
+  // Every batch up to this one can be read by the commands submitted to the
+  // graphics queue from now on
+  uint64_t get_ready_batch() const;
+  // Submit `batch` if still recording and wait until it is ready
+  void wait_for_batch(uint64_t batch);
+
+  // If the copies run on another queue than the graphics queue
+  bool is_asynchronous() const;
+  // Batches submitted and waits for ring space since the creation
+  uint64_t get_batch_count() const;
+  uint64_t get_stall_count() const;
+
+  static const size_t batch_count = 4;
+
+private:
+  /** Copies submitted together */
+  struct Batch {
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    // Ring position after the data of the batch
+    VkDeviceSize end = 0;
+    // Counted from 1
+    uint64_t number = 0;
+    bool recording = false;
+
+    /** Ownership transfer (asynchronous only) */
+    // Signaled with the copies, waited by the acquire
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    // Acquire of the buffers on the graphics queue (recorded by `flush()`)
+    VkCommandBuffer acquire_command_buffer = VK_NULL_HANDLE;
+    VkFence acquire_fence = VK_NULL_HANDLE;
+    // Buffer ranges copied by the batch
+    std::vector<VkBufferMemoryBarrier> barriers;
+  };
+
+  VkDevice device;
+  memory::DeviceAllocator &device_allocator;
+  uint32_t transfer_family;
+  VkQueue transfer_queue;
+  uint32_t graphics_family;
+  VkQueue graphics_queue;
+  const VkAllocationCallbacks *allocator;
+
+  memory::Buffer buffer;
+  VkDeviceSize size;
+  // Positions since the creation (modulo `size` in the buffer): the data of
+  // the batches in flight is between `tail` and `head`
+  VkDeviceSize head = 0;
+  VkDeviceSize tail = 0;
+
+  VkCommandPool command_pool = VK_NULL_HANDLE;
+  // Acquire command buffers (asynchronous only)
+  VkCommandPool acquire_command_pool = VK_NULL_HANDLE;
+  std::vector<Batch> batches;
+  // Batch recording (if `batches[current].recording`)
+  size_t current = 0;
+  // Indices of the batches submitted but not handed off (asynchronous only),
+  // then of the batches handed off, oldest first
+  std::deque<size_t> submitted;
+  std::deque<size_t> handed_off;
+
+  uint64_t submitted_batches = 0;
+  uint64_t ready_batch = 0;
+  uint64_t stalls = 0;
+
+  // Ring range of `size` bytes (waits for the oldest batches if full)
+  VkDeviceSize allocate(VkDeviceSize size);
+  // Free the ring space of the finished batches (`wait` for the oldest one)
+  void retire_batches(bool wait);
+  Batch &begin_batch();
+  // Submit the acquire of the oldest submitted batch
+  void submit_acquire();
+  // Fence signaled once the batch is ready and its ring space can be reused
+  VkFence get_completion_fence(const Batch &batch) const;
+};
+} // namespace staging
+} // namespace utils
+
+#endif
@@ -1,11 +1,17 @@
 #include "swapchain.hpp"
+
+#include "../trace/trace.hpp"
+
 #include <algorithm>
 #include <limits>
+#include <stdexcept>
 
 namespace utils {
 namespace swapchain {
 SwapChainSupportDetails query_swap_chain_support(VkSurfaceKHR surface,
                                                  VkPhysicalDevice device) {
+  utils::trace::Scope scope("utils::swapchain::query_swap_chain_support");
+
   SwapChainSupportDetails details;
 
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface,
@@ -50,23 +56,89 @@ VkSurfaceFormatKHR choose_swap_surface_format(
   return available_formats[0];
 }
 
-VkPresentModeKHR choose_swap_present_mode(
-    const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  // Fix variables
-  // (https://vulkan-tutorial.com/Drawing_a_triangle/Presentation/Swap_chain)
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return availablePresentMode;
-    }
+PresentPolicy parse_present_policy(const std::string &name) {
+  if (name == "latency") {
+    return PresentPolicy::LOWEST_LATENCY;
+  } else if (name == "power") {
+    return PresentPolicy::POWER_SAVING;
+  } else if (name == "throughput") {
+    return PresentPolicy::MAX_THROUGHPUT;
+  }
+
+  throw std::runtime_error("Unknown present policy: " + name);
+}
+
+std::string present_policy_name(PresentPolicy policy) {
+  switch (policy) {
+  case PresentPolicy::LOWEST_LATENCY:
+    return "latency";
+  case PresentPolicy::POWER_SAVING:
+    return "power";
+  case PresentPolicy::MAX_THROUGHPUT:
+    return "throughput";
   }
 
+  return "";
+}
+
+VkPresentModeKHR choose_swap_present_mode(
+    const std::vector<VkPresentModeKHR> &availablePresentModes,
+    PresentPolicy policy) {
   //  - VK_PRESENT_MODE_FIFO_KHR: Enables V-Sync (FPS is limited to the
   //    display's refresh rate).
   //  - VK_PRESENT_MODE_MAILBOX_KHR: Enables triple buffering with V-Sync (can
   //    reduce latency compared to FIFO).
   //  - VK_PRESENT_MODE_IMMEDIATE_KHR: Disables V-Sync (no FPS cap but may cause
   //    tearing).
-  return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  std::vector<VkPresentModeKHR> preferred;
+  switch (policy) {
+  case PresentPolicy::LOWEST_LATENCY:
+    preferred = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+    break;
+  case PresentPolicy::POWER_SAVING:
+    preferred = {};
+    break;
+  case PresentPolicy::MAX_THROUGHPUT:
+    preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+    break;
+  }
+
+  for (auto present_mode : preferred) {
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(),
+                  present_mode) != availablePresentModes.end()) {
+      return present_mode;
+    }
+  }
+
+  // The only mode required to be supported
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t choose_swap_image_count(const VkSurfaceCapabilitiesKHR &capabilities,
+                                 VkPresentModeKHR present_mode,
+                                 PresentPolicy policy) {
+  // Every queued image adds a frame of latency, but MAILBOX needs a third one
+  // to replace while one is displayed and one is rendered (otherwise it
+  // blocks like FIFO)
+  uint32_t image_count = 2;
+  if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR ||
+      policy == PresentPolicy::MAX_THROUGHPUT) {
+    image_count = 3;
+  }
+
+  // The CPU never waits for an image to be released
+  if (policy == PresentPolicy::MAX_THROUGHPUT) {
+    image_count = std::max(image_count, capabilities.minImageCount + 1);
+  }
+
+  image_count = std::max(image_count, capabilities.minImageCount);
+
+  // 0 = no limit
+  if (capabilities.maxImageCount > 0) {
+    image_count = std::min(image_count, capabilities.maxImageCount);
+  }
+
+  return image_count;
 }
 
 VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR &capabilities,
@@ -89,5 +161,54 @@ VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR &capabilities,
     return actualExtent;
   }
 }
+
+bool supports_present_wait(
+    VkInstance instance, VkPhysicalDevice physical_device,
+    const capability::NameSet &available_device_extensions) {
+  utils::trace::Scope scope("utils::swapchain::supports_present_wait");
+
+  if (!available_device_extensions.contains(
+          VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+      !available_device_extensions.contains(
+          VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    return false;
+  }
+
+  // Unlike the extensions, their features are optional
+  // (`VK_KHR_get_physical_device_properties2` is enabled on the instance)
+  auto get_features2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+      instance, "vkGetPhysicalDeviceFeatures2KHR");
+  if (get_features2 == nullptr) {
+    return false;
+  }
+
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+  present_wait_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+  VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+  present_id_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  present_id_features.pNext = &present_wait_features;
+
+  VkPhysicalDeviceFeatures2KHR features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features.pNext = &present_id_features;
+
+  get_features2(physical_device, &features);
+
+  return present_id_features.presentId && present_wait_features.presentWait;
+}
+
+PFN_vkWaitForPresentKHR load_wait_for_present(VkDevice device) {
+  auto wait_for_present = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(
+      device, "vkWaitForPresentKHR");
+
+  if (wait_for_present == nullptr) {
+    throw std::runtime_error("failed to load vkWaitForPresentKHR!");
+  }
+
+  return wait_for_present;
+}
 } // namespace swapchain
 } // namespace utils
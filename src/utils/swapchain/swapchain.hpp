@@ -3,8 +3,12 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <cstdint>
+#include <string>
 #include <vector>
 
+#include "../capability/capability.hpp"
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -13,14 +17,42 @@ struct SwapChainSupportDetails {
 
 namespace utils {
 namespace swapchain {
+/** Trade-off between latency, power and frame rate of the presentation */
+enum class PresentPolicy {
+  // Tear-free when possible (MAILBOX), as few images as possible and the CPU
+  // paced to start each frame just in time
+  LOWEST_LATENCY,
+  // V-Sync (FIFO, always supported) with as few images as possible, the CPU
+  // sleeps until the display is ready
+  POWER_SAVING,
+  // Uncapped frame rate (IMMEDIATE, may tear) with an extra image queued
+  MAX_THROUGHPUT,
+};
+
+// "latency", "power" or "throughput"
+PresentPolicy parse_present_policy(const std::string &name);
+std::string present_policy_name(PresentPolicy policy);
+
 SwapChainSupportDetails query_swap_chain_support(VkSurfaceKHR surface,
                                                  VkPhysicalDevice device);
 VkSurfaceFormatKHR choose_swap_surface_format(
     const std::vector<VkSurfaceFormatKHR> &available_formats);
 
-VkPresentModeKHR choose_swap_present_mode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+VkPresentModeKHR choose_swap_present_mode(
+    const std::vector<VkPresentModeKHR> &availablePresentModes,
+    PresentPolicy policy);
+uint32_t choose_swap_image_count(const VkSurfaceCapabilitiesKHR &capabilities,
+                                 VkPresentModeKHR present_mode,
+                                 PresentPolicy policy);
 
 VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities, int width, int height);
+
+// If the device can wait for a present to be displayed
+// (`VK_KHR_present_id` and `VK_KHR_present_wait` with their features)
+bool supports_present_wait(
+    VkInstance instance, VkPhysicalDevice physical_device,
+    const capability::NameSet &available_device_extensions);
+PFN_vkWaitForPresentKHR load_wait_for_present(VkDevice device);
 } // namespace swapchain
 } // namespace utils
 
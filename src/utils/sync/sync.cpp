@@ -0,0 +1,78 @@
+#include "sync.hpp"
+
+#include <stdexcept>
+
+namespace utils {
+namespace sync {
+bool supports_timeline_semaphore(
+    const capability::NameSet &available_device_extensions) {
+  return available_device_extensions.contains(
+      VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+}
+
+TimelineSemaphoreFunctions load_timeline_semaphore_functions(VkDevice device) {
+  TimelineSemaphoreFunctions functions;
+  functions.wait_semaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(
+      device, "vkWaitSemaphoresKHR");
+  functions.get_semaphore_counter_value =
+      (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(
+          device, "vkGetSemaphoreCounterValueKHR");
+
+  if (functions.wait_semaphores == nullptr ||
+      functions.get_semaphore_counter_value == nullptr) {
+    throw std::runtime_error("failed to load timeline semaphore functions!");
+  }
+
+  return functions;
+}
+
+VkSemaphore create_timeline_semaphore(VkDevice device,
+                                      uint64_t initial_value,
+                                      const VkAllocationCallbacks *allocator) {
+  // A semaphore is binary unless its type is chained
+  VkSemaphoreTypeCreateInfoKHR type_info{};
+  type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+  type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+  type_info.initialValue = initial_value;
+
+  VkSemaphoreCreateInfo semaphore_info{};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphore_info.pNext = &type_info;
+
+  VkSemaphore semaphore;
+  if (vkCreateSemaphore(device, &semaphore_info, allocator, &semaphore) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+
+  return semaphore;
+}
+
+void wait_timeline_semaphore(const TimelineSemaphoreFunctions &functions,
+                             VkDevice device, VkSemaphore semaphore,
+                             uint64_t value) {
+  VkSemaphoreWaitInfoKHR wait_info{};
+  wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+  wait_info.semaphoreCount = 1;
+  wait_info.pSemaphores = &semaphore;
+  wait_info.pValues = &value;
+
+  if (functions.wait_semaphores(device, &wait_info, UINT64_MAX) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to wait for timeline semaphore!");
+  }
+}
+
+uint64_t get_timeline_semaphore_value(
+    const TimelineSemaphoreFunctions &functions, VkDevice device,
+    VkSemaphore semaphore) {
+  uint64_t value = 0;
+  if (functions.get_semaphore_counter_value(device, semaphore, &value) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to get timeline semaphore value!");
+  }
+
+  return value;
+}
+} // namespace sync
+} // namespace utils
@@ -0,0 +1,38 @@
+#ifndef SYNC_HPP
+#define SYNC_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+
+#include "../capability/capability.hpp"
+
+namespace utils {
+namespace sync {
+/** Device functions of `VK_KHR_timeline_semaphore` (not exported by the
+ * loader with a Vulkan 1.0 instance) */
+struct TimelineSemaphoreFunctions {
+  PFN_vkWaitSemaphoresKHR wait_semaphores = nullptr;
+  PFN_vkGetSemaphoreCounterValueKHR get_semaphore_counter_value = nullptr;
+};
+
+// If the physical device has `VK_KHR_timeline_semaphore` (the
+// `timelineSemaphore` feature is then required to be supported)
+bool supports_timeline_semaphore(
+    const capability::NameSet &available_device_extensions);
+TimelineSemaphoreFunctions load_timeline_semaphore_functions(VkDevice device);
+
+VkSemaphore create_timeline_semaphore(VkDevice device, uint64_t initial_value,
+                                      const VkAllocationCallbacks *allocator);
+// Block until the counter of `semaphore` reaches `value`
+void wait_timeline_semaphore(const TimelineSemaphoreFunctions &functions,
+                             VkDevice device, VkSemaphore semaphore,
+                             uint64_t value);
+// Current counter of `semaphore` (non-blocking)
+uint64_t get_timeline_semaphore_value(
+    const TimelineSemaphoreFunctions &functions, VkDevice device,
+    VkSemaphore semaphore);
+} // namespace sync
+} // namespace utils
+
+#endif
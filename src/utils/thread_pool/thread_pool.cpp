@@ -0,0 +1,48 @@
+#include "thread_pool.hpp"
+
+namespace utils {
+namespace thread_pool {
+ThreadPool::ThreadPool(size_t thread_count) {
+  for (size_t i = 0; i < thread_count; ++i) {
+    this->workers.emplace_back([this]() { this->worker_loop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->condition.notify_all();
+
+  for (auto &worker : this->workers) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::size() const { return this->workers.size(); }
+
+void ThreadPool::worker_loop() {
+  while (true) {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->condition.wait(lock, [this]() {
+        return this->stopping || !this->tasks.empty();
+      });
+
+      // Only stop once every queued task was run
+      if (this->stopping && this->tasks.empty()) {
+        return;
+      }
+
+      task = std::move(this->tasks.front());
+      this->tasks.pop();
+    }
+
+    task();
+  }
+}
+} // namespace thread_pool
+} // namespace utils
@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace utils {
+namespace thread_pool {
+/** Fixed number of worker threads running the submitted tasks in order */
+class ThreadPool {
+public:
+  ThreadPool(size_t thread_count);
+  // Finish the queued tasks and join the workers
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Run `task` on a worker, the future holds its result (or exception)
+  template <typename F> auto submit(F &&task) -> std::future<decltype(task())> {
+    using Result = decltype(task());
+
+    // `std::function` must be copyable, `std::packaged_task` is not
+    auto packaged =
+        std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> result = packaged->get_future();
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->tasks.emplace([packaged]() { (*packaged)(); });
+    }
+    this->condition.notify_one();
+
+    return result;
+  }
+
+  size_t size() const;
+
+private:
+  void worker_loop();
+
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping = false;
+};
+} // namespace thread_pool
+} // namespace utils
+
+#endif
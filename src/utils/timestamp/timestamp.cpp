@@ -0,0 +1,58 @@
+#include "timestamp.hpp"
+
+#include <algorithm>
+
+namespace utils {
+namespace timestamp {
+RollingWindow::RollingWindow(size_t capacity)
+    : values(std::max<size_t>(capacity, 1), 0.0) {}
+
+void RollingWindow::push(double value) {
+  // The oldest sample leaves the window
+  if (this->count == this->values.size()) {
+    this->sum -= this->values[this->next];
+  } else {
+    ++this->count;
+  }
+
+  this->values[this->next] = value;
+  this->sum += value;
+  this->next = (this->next + 1) % this->values.size();
+}
+
+double RollingWindow::last() const {
+  if (this->count == 0) {
+    return 0.0;
+  }
+
+  return this->values[(this->next + this->values.size() - 1) %
+                      this->values.size()];
+}
+
+double RollingWindow::average() const {
+  return this->count == 0 ? 0.0 : this->sum / this->count;
+}
+
+double RollingWindow::max() const {
+  double max_value = 0.0;
+  for (size_t i = 0; i < this->count; ++i) {
+    max_value = std::max(max_value, this->values[i]);
+  }
+
+  return max_value;
+}
+
+size_t RollingWindow::size() const { return this->count; }
+
+double ticks_to_ms(uint64_t begin, uint64_t end, float timestamp_period,
+                   uint32_t valid_bits) {
+  // Only the `valid_bits` lower bits are written, masking the difference also
+  // handles the counter wrapping around between the two timestamps
+  uint64_t mask = valid_bits >= 64 ? ~0ULL : ((1ULL << valid_bits) - 1);
+  uint64_t ticks = (end - begin) & mask;
+
+  // `timestamp_period` is the number of nanoseconds per tick
+  return static_cast<double>(ticks) * timestamp_period / 1e6;
+}
+} // namespace timestamp
+} // namespace utils
@@ -0,0 +1,38 @@
+#ifndef TIMESTAMP_HPP
+#define TIMESTAMP_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace utils {
+namespace timestamp {
+/** Last `capacity` samples of a value (e.g. the GPU time of a pass) */
+class RollingWindow {
+public:
+  RollingWindow(size_t capacity = 120);
+
+  void push(double value);
+
+  double last() const;
+  double average() const;
+  double max() const;
+  size_t size() const;
+
+private:
+  std::vector<double> values;
+  // Slot that receives the next sample (the oldest one when full)
+  size_t next = 0;
+  size_t count = 0;
+  double sum = 0.0;
+};
+
+// Convert the difference between two timestamps to milliseconds
+double ticks_to_ms(uint64_t begin, uint64_t end, float timestamp_period,
+                   uint32_t valid_bits);
+} // namespace timestamp
+} // namespace utils
+
+#endif
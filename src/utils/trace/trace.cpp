@@ -0,0 +1,113 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace utils {
+namespace trace {
+/** Complete event ("ph": "X") of the trace */
+struct Event {
+  const char *name;
+  // Microseconds since `epoch`
+  int64_t start_us;
+  int64_t duration_us;
+  uint32_t thread;
+};
+
+static std::atomic<bool> enabled{false};
+static std::atomic<bool> verbose{false};
+
+// Timestamps are relative to the first use of the tracer
+static const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
+
+static std::mutex events_mutex;
+static std::vector<Event> events;
+// Small ids (order of the first event) instead of the hashes of the threads
+static std::unordered_map<std::thread::id, uint32_t> thread_ids;
+
+// Without a buffer every write fails (and is ignored). One per thread: a
+// failed write sets the state of the stream, `out()` is used by the
+// pipeline workers too.
+static thread_local std::ostream null_stream(nullptr);
+
+static int64_t to_us(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+void set_enabled(bool enable) { enabled = enable; }
+
+bool is_enabled() { return enabled; }
+
+void set_verbose(bool enable) { verbose = enable; }
+
+std::ostream &out() { return verbose ? std::cout : null_stream; }
+
+Scope::Scope(const char *name) : name(name), recording(enabled) {
+  if (verbose) {
+    std::cout << "\n\n\n -> " << name << std::endl;
+  }
+
+  if (this->recording) {
+    this->start = std::chrono::steady_clock::now();
+  }
+}
+
+Scope::~Scope() {
+  if (!this->recording) {
+    return;
+  }
+
+  auto end = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock(events_mutex);
+  auto thread = thread_ids
+                    .emplace(std::this_thread::get_id(),
+                             static_cast<uint32_t>(thread_ids.size()))
+                    .first->second;
+
+  events.push_back({this->name, to_us(this->start - epoch),
+                    to_us(end - this->start), thread});
+}
+
+void write_chrome_trace(const std::string &path) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open " + path);
+  }
+
+  // The trace is written once: the scopes of the runtime paths (swap chain
+  // recreation, pipeline workers, hot reload) are no longer recorded
+  enabled = false;
+
+  std::lock_guard<std::mutex> lock(events_mutex);
+
+  file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event &event = events[i];
+
+    // The names are identifiers, nothing to escape
+    file << "  {\"name\": \"" << event.name
+         << "\", \"cat\": \"lvk\", \"ph\": \"X\", \"ts\": " << event.start_us
+         << ", \"dur\": " << event.duration_us
+         << ", \"pid\": 1, \"tid\": " << event.thread << "}"
+         << (i + 1 == events.size() ? "" : ",") << "\n";
+  }
+  file << "]}\n";
+
+  out() << "Trace written to " << path << " (" << events.size()
+        << " events)" << std::endl;
+
+  events.clear();
+  events.shrink_to_fit();
+}
+} // namespace trace
+} // namespace utils
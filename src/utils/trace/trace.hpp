@@ -0,0 +1,43 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <ostream>
+#include <string>
+
+namespace utils {
+namespace trace {
+// Record the phases (off by default, each phase costs a lock when on)
+void set_enabled(bool enabled);
+bool is_enabled();
+
+// Print the phases (and the details of the initialization) on stdout
+void set_verbose(bool verbose);
+// `std::cout` when verbose, otherwise a stream of the calling thread that
+// discards everything
+std::ostream &out();
+
+/** Phase recorded from the construction to the destruction of the scope */
+class Scope {
+public:
+  // `name` must outlive the scope (string literal)
+  explicit Scope(const char *name);
+  ~Scope();
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  const char *name;
+  bool recording;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Write the recorded phases as Chrome trace events (JSON), to open with
+// `chrome://tracing` or https://ui.perfetto.dev. Then stop recording and
+// drop the phases (the memory doesn't grow with the session).
+void write_chrome_trace(const std::string &path);
+} // namespace trace
+} // namespace utils
+
+#endif
@@ -0,0 +1,82 @@
+#include "uniform.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace utils {
+namespace uniform {
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformRing::UniformRing(memory::DeviceAllocator &device_allocator,
+                         const VkPhysicalDeviceLimits &limits,
+                         uint32_t region_count, VkDeviceSize region_size)
+    : device_allocator(device_allocator),
+      alignment(std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment,
+                                       1)),
+      region_count(region_count) {
+  this->region_size = align_up(region_size, this->alignment);
+
+  // The dynamic offsets are 32 bits
+  if (this->region_size * region_count > UINT32_MAX) {
+    throw std::runtime_error("uniform ring is too big!");
+  }
+
+  VkBufferCreateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = this->region_size * region_count;
+  buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // Read once per frame by the GPU, no staging copy is worth it
+  this->buffer = this->device_allocator.create_buffer(
+      buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+UniformRing::~UniformRing() {
+  this->device_allocator.destroy_buffer(this->buffer);
+}
+
+void UniformRing::begin_region(uint32_t region) {
+  if (region >= this->region_count) {
+    throw std::runtime_error("uniform ring region out of range!");
+  }
+
+  this->region_start = region * this->region_size;
+  this->head = this->region_start;
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size) {
+  if (this->head + size > this->region_start + this->region_size) {
+    throw std::runtime_error("uniform ring region is full!");
+  }
+
+  UniformAllocation allocation;
+  allocation.data =
+      static_cast<char *>(this->buffer.allocation.mapped) + this->head;
+  allocation.offset = static_cast<uint32_t>(this->head);
+
+  this->head = align_up(this->head + size, this->alignment);
+
+  return allocation;
+}
+
+VkDeviceSize UniformRing::get_allocation_size(VkDeviceSize size) const {
+  return align_up(size, this->alignment);
+}
+
+VkBuffer UniformRing::get_buffer() const { return this->buffer.buffer; }
+
+uint32_t UniformRing::get_region_count() const { return this->region_count; }
+
+VkDeviceSize UniformRing::get_region_size() const {
+  return this->region_size;
+}
+
+VkDeviceSize UniformRing::get_used_bytes() const {
+  return this->head - this->region_start;
+}
+} // namespace uniform
+} // namespace utils
@@ -0,0 +1,73 @@
+#ifndef UNIFORM_HPP
+#define UNIFORM_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <cstring>
+
+#include "../memory/memory.hpp"
+
+namespace utils {
+namespace uniform {
+/** Range of the ring written by the CPU this frame */
+struct UniformAllocation {
+  // Persistently mapped (coherent, nothing to flush)
+  void *data = nullptr;
+  // Dynamic offset of the range in the buffer
+  uint32_t offset = 0;
+};
+
+/** Host visible buffer of the uniforms that change every frame */
+// The buffer is split in regions, one per frame that can be in flight (or
+// per command buffer replaying the offsets). The data of a frame is
+// bump-allocated in its region and bound with dynamic offsets: no
+// allocation, no map/unmap and no descriptor update per frame. A region is
+// only rewritten by `begin_region()`, once the GPU is done with it.
+class UniformRing {
+public:
+  // `region_size` is rounded up to `minUniformBufferOffsetAlignment`
+  UniformRing(memory::DeviceAllocator &device_allocator,
+              const VkPhysicalDeviceLimits &limits, uint32_t region_count,
+              VkDeviceSize region_size);
+  ~UniformRing();
+
+  UniformRing(const UniformRing &) = delete;
+  UniformRing &operator=(const UniformRing &) = delete;
+
+  // Allocate from the start of `region` (the frame that last used it must be
+  // finished): the same sequence of allocations gets the same offsets
+  void begin_region(uint32_t region);
+  // `size` bytes aligned for a dynamic offset, throws if the region is full
+  UniformAllocation allocate(VkDeviceSize size);
+  // Copy `value` to a new range, returns its dynamic offset
+  template <typename T> uint32_t push(const T &value) {
+    UniformAllocation allocation = this->allocate(sizeof(T));
+    std::memcpy(allocation.data, &value, sizeof(T));
+    return allocation.offset;
+  }
+
+  // Bytes of a region taken by an allocation of `size`
+  VkDeviceSize get_allocation_size(VkDeviceSize size) const;
+
+  VkBuffer get_buffer() const;
+  uint32_t get_region_count() const;
+  VkDeviceSize get_region_size() const;
+  // Bytes allocated in the current region
+  VkDeviceSize get_used_bytes() const;
+
+private:
+  memory::DeviceAllocator &device_allocator;
+  memory::Buffer buffer;
+  VkDeviceSize alignment;
+  uint32_t region_count;
+  VkDeviceSize region_size;
+
+  // Start of the current region and next free byte in it
+  VkDeviceSize region_start = 0;
+  VkDeviceSize head = 0;
+};
+} // namespace uniform
+} // namespace utils
+
+#endif
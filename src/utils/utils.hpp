@@ -8,12 +8,29 @@ const bool enable_validation_layer = false;
 const bool enable_validation_layer = true;
 #endif
 
+#include "allocator/allocator.hpp"
+#include "capability/capability.hpp"
+#include "culling/culling.hpp"
 #include "device/device.hpp"
 #include "extension/extension.hpp"
 #include "file/file.hpp"
+#include "instance/instance.hpp"
 #include "layer/layer.hpp"
+#include "log/log.hpp"
+#include "memory/memory.hpp"
+#include "mesh/mesh.hpp"
 #include "messenger/messenger.hpp"
+#include "pipeline/pipeline.hpp"
+#include "pipeline_cache/pipeline_cache.hpp"
 #include "queue/queue.hpp"
+#include "shader/shader.hpp"
+#include "staging/staging.hpp"
 #include "swapchain/swapchain.hpp"
+#include "sync/sync.hpp"
+#include "thread_pool/thread_pool.hpp"
+#include "timestamp/timestamp.hpp"
+#include "trace/trace.hpp"
+#include "uniform/uniform.hpp"
+#include "watch/watch.hpp"
 
 #endif
@@ -0,0 +1,60 @@
+#include "watch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace utils {
+namespace watch {
+DirectoryWatcher::DirectoryWatcher(const std::string &directory)
+    : directory(directory) {
+  this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (this->fd == -1) {
+    throw std::runtime_error(std::string("failed to init inotify: ") +
+                             std::strerror(errno));
+  }
+
+  // Editors either write the file (close after write) or replace it (move)
+  if (inotify_add_watch(this->fd, directory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+    int error = errno;
+    close(this->fd);
+    throw std::runtime_error("failed to watch " + directory + ": " +
+                             std::strerror(error));
+  }
+}
+
+DirectoryWatcher::~DirectoryWatcher() { close(this->fd); }
+
+std::vector<std::string> DirectoryWatcher::poll() {
+  std::vector<std::string> names;
+
+  // Events are never split between two reads
+  alignas(struct inotify_event) char buffer[4096];
+
+  ssize_t length;
+  while ((length = read(this->fd, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t offset = 0; offset < length;) {
+      const auto *event =
+          reinterpret_cast<const struct inotify_event *>(buffer + offset);
+
+      if (event->len > 0 && std::find(names.begin(), names.end(),
+                                      event->name) == names.end()) {
+        names.push_back(event->name);
+      }
+
+      offset += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  return names;
+}
+
+const std::string &DirectoryWatcher::get_directory() const {
+  return this->directory;
+}
+} // namespace watch
+} // namespace utils
@@ -0,0 +1,32 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+#include <string>
+#include <vector>
+
+namespace utils {
+namespace watch {
+/** Files written in a directory (inotify, not recursive) */
+class DirectoryWatcher {
+public:
+  // Throws if the directory can't be watched
+  explicit DirectoryWatcher(const std::string &directory);
+  ~DirectoryWatcher();
+
+  DirectoryWatcher(const DirectoryWatcher &) = delete;
+  DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+  // Names of the files written (or moved in) since the last call, each once.
+  // Non-blocking, cheap enough to be called every frame.
+  std::vector<std::string> poll();
+
+  const std::string &get_directory() const;
+
+private:
+  std::string directory;
+  int fd = -1;
+};
+} // namespace watch
+} // namespace utils
+
+#endif